@@ -0,0 +1,224 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "bench.h"
+#include "eat.h"
+#include "util.h"
+
+#if defined(__linux__) && !defined(MADV_POPULATE_WRITE)
+#define MADV_POPULATE_WRITE 23
+#endif
+
+#define CHUNK 1024
+#define ALIGNMENT (2 * 1024 * 1024)
+
+// Each strategy allocates and fills [total] bytes, returning an opaque handle
+// for its release function, or NULL if the strategy failed or is unsupported.
+typedef struct {
+    const char* name;
+    void* (*fill)(long total);
+    void (*release)(void* handle, long total);
+} Strategy;
+
+static void touch_pages(char* base, long total) {
+    long page = sysconf(_SC_PAGE_SIZE);
+    for(long i = 0; i < total; i += page) {
+        base[i] = 1;
+    }
+}
+
+// Allocates like eat() but always fills with memset, whatever --fill selects,
+// so the strategy measures what its name says.
+static void* fill_malloc(long total) {
+    short** chunks = malloc(sizeof(short*) * ((total + CHUNK - 1) / CHUNK));
+    if(chunks == NULL) {
+        return NULL;
+    }
+    for(long i = 0; i < total; i += CHUNK) {
+        short* buffer = malloc(CHUNK);
+        if(buffer == NULL) {
+            digest(chunks, i, CHUNK);
+            free(chunks);
+            return NULL;
+        }
+        memset(buffer, 0, CHUNK);
+        chunks[i / CHUNK] = buffer;
+    }
+    return chunks;
+}
+
+static void release_malloc(void* handle, long total) {
+    digest(handle, total, CHUNK);
+    free(handle);
+}
+
+static void* fill_calloc(long total) {
+    char* base = calloc(1, total);
+    if(base) {
+        touch_pages(base, total);
+    }
+    return base;
+}
+
+static void* fill_memalign(long total) {
+    void* base;
+    if(posix_memalign(&base, ALIGNMENT, total) != 0) {
+        return NULL;
+    }
+    memset(base, 0, total);
+    return base;
+}
+
+static void release_free(void* handle, long total) {
+    (void)total;
+    free(handle);
+}
+
+static void* map(long total, int flags) {
+    void* base = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+    return base == MAP_FAILED ? NULL : base;
+}
+
+static void* fill_mmap(long total) {
+    char* base = map(total, 0);
+    if(base) {
+#ifdef MADV_NOHUGEPAGE
+        madvise(base, total, MADV_NOHUGEPAGE);
+#endif
+        touch_pages(base, total);
+    }
+    return base;
+}
+
+static void release_munmap(void* handle, long total) {
+    munmap(handle, total);
+}
+
+#ifdef MAP_POPULATE
+static void* fill_populate(long total) {
+    return map(total, MAP_POPULATE);
+}
+#endif
+
+#ifdef __linux__
+static void* fill_populate_write(long total) {
+    char* base = map(total, 0);
+    if(base && madvise(base, total, MADV_POPULATE_WRITE) != 0) {
+        munmap(base, total);
+        return NULL;
+    }
+    return base;
+}
+
+static void* fill_thp(long total) {
+    char* base = map(total, 0);
+    if(base) {
+        madvise(base, total, MADV_HUGEPAGE);
+        touch_pages(base, total);
+    }
+    return base;
+}
+
+static void* fill_hugetlb(long total) {
+    long huge = 2 * 1024 * 1024;
+    return map((total + huge - 1) / huge * huge, MAP_HUGETLB | MAP_POPULATE);
+}
+
+static void release_hugetlb(void* handle, long total) {
+    long huge = 2 * 1024 * 1024;
+    munmap(handle, (total + huge - 1) / huge * huge);
+}
+#endif
+
+static const Strategy strategies[] = {
+    {"malloc+memset", fill_malloc, release_malloc},
+    {"calloc", fill_calloc, release_free},
+    {"posix_memalign", fill_memalign, release_free},
+    {"mmap+touch", fill_mmap, release_munmap},
+#ifdef MAP_POPULATE
+    {"mmap+MAP_POPULATE", fill_populate, release_munmap},
+#endif
+#ifdef __linux__
+    {"MADV_POPULATE_WRITE", fill_populate_write, release_munmap},
+    {"THP+touch", fill_thp, release_munmap},
+    {"MAP_HUGETLB", fill_hugetlb, release_hugetlb},
+#endif
+};
+
+#define STRATEGY_COUNT ((int)(sizeof(strategies) / sizeof(strategies[0])))
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Returns the median of the sorted [samples].
+static double median(const double* samples, int count) {
+    return count % 2 ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) / 2;
+}
+
+int eat_bench(long total, int repeat, const char* json_path) {
+    double* samples = malloc(sizeof(double) * repeat * STRATEGY_COUNT);
+    bool* supported = calloc(STRATEGY_COUNT, sizeof(bool));
+    if(samples == NULL || supported == NULL) {
+        printf("ERROR: Could not allocate the results\n");
+        return 1;
+    }
+
+    printf("%-20s  %10s  %10s  %10s  %10s\n", "STRATEGY", "MEDIAN_MS", "MIN_MS", "MAX_MS", "GB/S");
+    for(int s = 0; s < STRATEGY_COUNT; s++) {
+        double* ms = samples + s * repeat;
+        supported[s] = true;
+        for(int r = 0; r < repeat && supported[s]; r++) {
+            long long start = now_ns();
+            void* handle = strategies[s].fill(total);
+            ms[r] = (now_ns() - start) / 1e6;
+            if(handle == NULL) {
+                supported[s] = false;
+            } else {
+                strategies[s].release(handle, total);
+            }
+        }
+        if(!supported[s]) {
+            printf("%-20s  %10s\n", strategies[s].name, "unsupported");
+            continue;
+        }
+        qsort(ms, repeat, sizeof(double), compare_doubles);
+        double m = median(ms, repeat);
+        printf("%-20s  %10.1f  %10.1f  %10.1f  %10.2f\n", strategies[s].name,
+            m, ms[0], ms[repeat - 1], total / (m / 1e3) / 1e9);
+        fflush(stdout);
+    }
+
+    if(json_path != NULL) {
+        FILE* f = fopen(json_path, "w");
+        if(f == NULL) {
+            perror(json_path);
+        } else {
+            fprintf(f, "{\n  \"size\": %ld,\n  \"repeat\": %d,\n  \"results\": [\n", total, repeat);
+            for(int s = 0; s < STRATEGY_COUNT; s++) {
+                double* ms = samples + s * repeat;
+                fprintf(f, "    {\"strategy\": \"%s\", \"supported\": %s", strategies[s].name, supported[s] ? "true" : "false");
+                if(supported[s]) {
+                    fprintf(f, ", \"median_ms\": %.3f, \"min_ms\": %.3f, \"max_ms\": %.3f, \"samples_ms\": [", median(ms, repeat), ms[0], ms[repeat - 1]);
+                    for(int r = 0; r < repeat; r++) {
+                        fprintf(f, "%s%.3f", r ? ", " : "", ms[r]);
+                    }
+                    fprintf(f, "]");
+                }
+                fprintf(f, "}%s\n", s < STRATEGY_COUNT - 1 ? "," : "");
+            }
+            fprintf(f, "  ]\n}\n");
+            fclose(f);
+        }
+    }
+
+    free(supported);
+    free(samples);
+    return 0;
+}
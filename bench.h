@@ -0,0 +1,10 @@
+#ifndef bench_h
+#define bench_h
+
+// Measures how long it takes to fill [total] bytes with each allocation
+// strategy, [repeat] times each, and prints the median and spread as a table.
+// The results are also written as JSON to [json_path] if it is not NULL.
+// Returns the process exit code.
+int eat_bench(long total, int repeat, const char* json_path);
+
+#endif
@@ -0,0 +1,236 @@
+#define _GNU_SOURCE
+
+#include "cache.h"
+
+#ifdef CACHE_MODE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "util.h"
+
+#define REPORT_INTERVAL_NS 1000000000LL
+
+typedef struct {
+    int cpu;
+    long size;
+    long line;
+    // Written by the worker, read by the reporting thread.
+    volatile long long lines;
+    char padding[64];
+} CacheWorker;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void request_stop(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static long read_cache_attr(int cpu, int index, const char* attr, char* buf, size_t len) {
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/%s", cpu, index, attr);
+    FILE* f = fopen(path, "r");
+    if(f == NULL) {
+        return -1;
+    }
+    char* line = fgets(buf, len, f);
+    fclose(f);
+    if(line == NULL) {
+        return -1;
+    }
+    buf[strcspn(buf, "\n")] = 0;
+    char* end;
+    long value = strtol(buf, &end, 10);
+    if(*end == 'K') {
+        value *= 1024;
+    } else if(*end == 'M') {
+        value *= 1024 * 1024;
+    }
+    return value;
+}
+
+// Finds the last-level cache of [cpu], returning its size and line size and
+// the CPUs that share it. Returns false if sysfs does not describe it.
+static bool last_level_cache(int cpu, long* size, long* line, char* shared, size_t len) {
+    int best = -1, best_level = 0;
+    char buf[256];
+    for(int index = 0; index < 16; index++) {
+        long level = read_cache_attr(cpu, index, "level", buf, sizeof(buf));
+        if(level < 0) {
+            break;
+        }
+        read_cache_attr(cpu, index, "type", buf, sizeof(buf));
+        if(level > best_level && strcmp(buf, "Instruction") != 0) {
+            best = index;
+            best_level = level;
+        }
+    }
+    if(best < 0) {
+        return false;
+    }
+    *size = read_cache_attr(cpu, best, "size", buf, sizeof(buf));
+    *line = read_cache_attr(cpu, best, "coherency_line_size", buf, sizeof(buf));
+    if(*line <= 0) {
+        *line = 64;
+    }
+    return *size > 0 && read_cache_attr(cpu, best, "shared_cpu_list", shared, len) >= 0;
+}
+
+long last_level_cache_size(int cpu) {
+    long size, line;
+    char shared[256];
+    return last_level_cache(cpu, &size, &line, shared, sizeof(shared)) ? size : -1;
+}
+
+// Returns the first CPU of a list like "0-3,8-11".
+static int first_cpu(const char* list) {
+    return atoi(list);
+}
+
+static bool first_sibling(int cpu) {
+    char path[128], buf[256];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    FILE* f = fopen(path, "r");
+    if(f == NULL) {
+        return true;
+    }
+    bool first = fgets(buf, sizeof(buf), f) == NULL || first_cpu(buf) == cpu;
+    fclose(f);
+    return first;
+}
+
+static void* walk(void* arg) {
+    CacheWorker* w = arg;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(w->cpu, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+
+    // Allocated after pinning so the working set is local to the CPU.
+    volatile char* data = malloc(w->size);
+    if(data == NULL) {
+        return NULL;
+    }
+    memset((char*)data, 0, w->size);
+    long lines = w->size / w->line;
+    while(!stop_requested) {
+        for(long i = 0; i < w->size; i += w->line) {
+            data[i]++;
+        }
+        w->lines += lines;
+    }
+    free((char*)data);
+    return NULL;
+}
+
+int eat_cache(double fraction, bool per_core, int timeout) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    CacheWorker* workers = calloc(cpus, sizeof(CacheWorker));
+    pthread_t* threads = calloc(cpus, sizeof(pthread_t));
+    char (*domains)[256] = calloc(cpus, 256);
+    int* domain_workers = calloc(cpus, sizeof(int));
+    int* worker_domain = calloc(cpus, sizeof(int));
+    if(workers == NULL || threads == NULL || domains == NULL || domain_workers == NULL || worker_domain == NULL) {
+        printf("ERROR: Could not allocate the workers\n");
+        return 1;
+    }
+
+    // One domain per distinct last-level cache, and one worker per domain or
+    // per physical core within it.
+    int count = 0, domain_count = 0;
+    for(int cpu = 0; cpu < cpus; cpu++) {
+        long size, line;
+        char shared[256];
+        if(!last_level_cache(cpu, &size, &line, shared, sizeof(shared))) {
+            continue;
+        }
+        int d = 0;
+        while(d < domain_count && strcmp(domains[d], shared) != 0) {
+            d++;
+        }
+        if(d == domain_count) {
+            snprintf(domains[domain_count++], 256, "%s", shared);
+            printf("LLC %d: %ld KiB, %ld byte lines, CPUs %s\n", d, size / 1024, line, shared);
+        }
+        if(per_core ? !first_sibling(cpu) : domain_workers[d] > 0) {
+            continue;
+        }
+        workers[count].cpu = cpu;
+        workers[count].size = (long)(size * fraction);
+        workers[count].line = line;
+        worker_domain[count++] = d;
+        domain_workers[d]++;
+    }
+    if(count == 0) {
+        printf("ERROR: Could not find the last-level cache in sysfs\n");
+        return 1;
+    }
+    for(int i = 0; i < count; i++) {
+        workers[i].size = workers[i].size / domain_workers[worker_domain[i]] / workers[i].line * workers[i].line;
+        if(workers[i].size < workers[i].line) {
+            workers[i].size = workers[i].line;
+        }
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = request_stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    for(int i = 0; i < count; i++) {
+        printf("Worker %d: CPU %d, %ld KiB working set\n", i, workers[i].cpu, workers[i].size / 1024);
+        if(pthread_create(&threads[i], NULL, walk, &workers[i]) != 0) {
+            printf("ERROR: Could not start the workers\n");
+            stop_requested = 1;
+            count = i;
+            break;
+        }
+    }
+
+    long long* last = calloc(count, sizeof(long long));
+    long long start = now_ns(), last_report = start;
+    long long deadline = timeout >= 0 ? start + timeout * 1000000000LL : -1;
+    printf("%8s  %16s  %s\n", "TIME_S", "TOTAL_LINES/S", "PER_WORKER_LINES/S");
+    while(!stop_requested && last != NULL && (deadline < 0 || now_ns() < deadline)) {
+        long long wait = REPORT_INTERVAL_NS;
+        if(deadline >= 0 && deadline - now_ns() < wait) {
+            wait = deadline - now_ns();
+        }
+        sleep_ns(wait, &stop_requested);
+        long long now = now_ns();
+        double secs = (now - last_report) / 1e9;
+        double total = 0;
+        char per_worker[512] = "";
+        for(int i = 0; i < count; i++) {
+            long long lines = workers[i].lines;
+            double rate = (lines - last[i]) / secs;
+            total += rate;
+            last[i] = lines;
+            size_t used = strlen(per_worker);
+            snprintf(per_worker + used, sizeof(per_worker) - used, "%s%.3g", i ? " " : "", rate);
+        }
+        last_report = now;
+        printf("%8.1f  %16.4g  %s\n", (now - start) / 1e9, total, per_worker);
+        fflush(stdout);
+    }
+
+    stop_requested = 1;
+    for(int i = 0; i < count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(last);
+    free(worker_domain);
+    free(domain_workers);
+    free(domains);
+    free(threads);
+    free(workers);
+    return 0;
+}
+
+#endif
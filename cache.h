@@ -0,0 +1,25 @@
+#ifndef cache_h
+#define cache_h
+
+#include <stdbool.h>
+
+#ifdef __linux__
+#define CACHE_MODE
+#endif
+
+#ifdef CACHE_MODE
+
+// Keeps a working set of [fraction] of each last-level cache resident by
+// walking it a cache line at a time, from one thread per cache ([per_core]
+// false) or one thread per physical core sharing it ([per_core] true), each
+// pinned to its CPU. Reports the access rate every second for [timeout]
+// seconds, or until interrupted if negative. Returns the process exit code.
+int eat_cache(double fraction, bool per_core, int timeout);
+
+// Returns the size in bytes of the last-level cache of [cpu], or -1 if sysfs
+// does not describe it.
+long last_level_cache_size(int cpu);
+
+#endif
+
+#endif
@@ -0,0 +1,188 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <ctype.h>
+#include "churn.h"
+#include "histogram.h"
+#include "util.h"
+
+#define MAX_SIZE_CLASSES 64
+#define REPORT_INTERVAL_NS 1000000000LL
+
+// Every object starts with this header, which links it into the bucket of the
+// step it expires in.
+typedef struct Object {
+    struct Object* next;
+    size_t size;
+} Object;
+
+typedef struct {
+    size_t sizes[MAX_SIZE_CLASSES];
+    long cumulative[MAX_SIZE_CLASSES];
+    int count;
+} SizeClasses;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void request_stop(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static bool parse_size_classes(const char* text, SizeClasses* classes) {
+    classes->count = 0;
+    long total_weight = 0;
+    const char* p = text;
+    while(*p) {
+        char* end;
+        long size = strtol(p, &end, 10);
+        if(end == p || size <= 0) {
+            return false;
+        }
+        if(toupper(*end) == 'K') {
+            size *= 1024;
+            end++;
+        } else if(toupper(*end) == 'M') {
+            size *= 1024 * 1024;
+            end++;
+        }
+        if(*end != ':') {
+            return false;
+        }
+        p = end + 1;
+        long weight = strtol(p, &end, 10);
+        if(end == p || weight <= 0 || classes->count == MAX_SIZE_CLASSES) {
+            return false;
+        }
+        total_weight += weight;
+        classes->sizes[classes->count] = size < (long)sizeof(Object) ? sizeof(Object) : (size_t)size;
+        classes->cumulative[classes->count++] = total_weight;
+        p = *end == ',' ? end + 1 : end;
+        if(*end != ',' && *end != 0) {
+            return false;
+        }
+    }
+    return classes->count > 0;
+}
+
+static size_t pick_size(const SizeClasses* classes, unsigned long long* rng) {
+    long r = xorshift(rng) % classes->cumulative[classes->count - 1];
+    int i = 0;
+    while(classes->cumulative[i] <= r) {
+        i++;
+    }
+    return classes->sizes[i];
+}
+
+static void print_percentiles(const char* name, const Histogram* hist) {
+    printf("%-6s p50 %lld ns, p90 %lld ns, p99 %lld ns, p99.9 %lld ns, max %lld ns\n", name,
+        hist_percentile(hist, 50), hist_percentile(hist, 90), hist_percentile(hist, 99),
+        hist_percentile(hist, 99.9), hist->max);
+}
+
+int eat_churn(long total, const char* sizes, int lifetime, int timeout) {
+    SizeClasses classes;
+    if(!parse_size_classes(sizes, &classes)) {
+        printf("ERROR: Invalid size classes %s\n", sizes);
+        return 1;
+    }
+
+    // Objects expire into a timing wheel with one bucket per step; lifetimes
+    // are uniform in [1, 2 * lifetime - 1] so they average [lifetime] steps.
+    int wheel_size = 2 * lifetime;
+    Object** wheel = calloc(wheel_size, sizeof(Object*));
+    Histogram* malloc_hist = malloc(sizeof(Histogram));
+    Histogram* free_hist = malloc(sizeof(Histogram));
+    if(wheel == NULL || malloc_hist == NULL || free_hist == NULL) {
+        printf("ERROR: Could not allocate the timing wheel\n");
+        return 1;
+    }
+    hist_clear(malloc_hist);
+    hist_clear(free_hist);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = request_stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    unsigned long long rng = 0x9e3779b97f4a7c15ULL;
+    long live = 0;
+    long long ops = 0, last_ops = 0;
+    double max_bloat = 0;
+    long long start = now_ns(), last_report = start;
+    long long deadline = timeout >= 0 ? start + timeout * 1000000000LL : -1;
+    int status = 0;
+
+    printf("%8s  %12s  %12s  %12s  %8s\n", "TIME_S", "OPS/S", "LIVE_KB", "RSS_KB", "BLOAT");
+    for(long long step = 0; !stop_requested; step++) {
+        int slot = step % wheel_size;
+        Object* obj = wheel[slot];
+        while(obj != NULL) {
+            Object* next = obj->next;
+            live -= obj->size;
+            long long t = now_ns();
+            free(obj);
+            hist_record(free_hist, now_ns() - t);
+            ops++;
+            obj = next;
+        }
+        wheel[slot] = NULL;
+
+        while(live < total) {
+            size_t size = pick_size(&classes, &rng);
+            long long t = now_ns();
+            obj = malloc(size);
+            hist_record(malloc_hist, now_ns() - t);
+            ops++;
+            if(obj == NULL) {
+                printf("ERROR: Could not allocate the memory\n");
+                stop_requested = 1;
+                status = 1;
+                break;
+            }
+            memset(obj, 0, size);
+            obj->size = size;
+            int expires = (step + 1 + xorshift(&rng) % (wheel_size - 1)) % wheel_size;
+            obj->next = wheel[expires];
+            wheel[expires] = obj;
+            live += size;
+        }
+
+        long long now = now_ns();
+        if(now - last_report >= REPORT_INTERVAL_NS || (deadline >= 0 && now >= deadline)) {
+            long long rss = rss_bytes();
+            double bloat = rss > 0 ? (double)rss / live - 1 : 0;
+            max_bloat = bloat > max_bloat ? bloat : max_bloat;
+            printf("%8.1f  %12.0f  %12ld  %12lld  %7.1f%%\n", (now - start) / 1e9,
+                (ops - last_ops) / ((now - last_report) / 1e9), live / 1024, rss / 1024, bloat * 100);
+            fflush(stdout);
+            last_report = now;
+            last_ops = ops;
+            if(deadline >= 0 && now >= deadline) {
+                break;
+            }
+        }
+    }
+
+    double secs = (now_ns() - start) / 1e9;
+    printf("\n%lld ops in %.1f s (%.0f ops/s), max RSS bloat %.1f%%\n", ops, secs, ops / secs, max_bloat * 100);
+    print_percentiles("malloc", malloc_hist);
+    print_percentiles("free", free_hist);
+
+    for(int i = 0; i < wheel_size; i++) {
+        for(Object* obj = wheel[i]; obj != NULL; ) {
+            Object* next = obj->next;
+            free(obj);
+            obj = next;
+        }
+    }
+    free(free_hist);
+    free(malloc_hist);
+    free(wheel);
+    return status;
+}
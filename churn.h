@@ -0,0 +1,13 @@
+#ifndef churn_h
+#define churn_h
+
+// Keeps about [total] bytes of live heap while continuously allocating and
+// freeing objects with sizes drawn from [sizes], a comma separated list of
+// size:weight pairs (e.g. "16:50,256:30,4096:20"), each living [lifetime]
+// steps on average. Reports ops/sec, RSS bloat over the live bytes and malloc
+// and free latency percentiles every second and at the end. Runs for
+// [timeout] seconds, or until interrupted if negative. Returns the process
+// exit code.
+int eat_churn(long total, const char* sizes, int lifetime, int timeout);
+
+#endif
@@ -0,0 +1,270 @@
+#define _GNU_SOURCE
+
+#include "coherence.h"
+
+#ifdef COHERENCE_MODE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <signal.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "util.h"
+
+#define LINE 64
+#define REPORT_INTERVAL_NS 1000000000LL
+#define WRITE_BATCH 1024
+#define PING_PONGS 20000
+// Largest number of CPUs in the latency matrix, which takes one ping-pong
+// run per pair.
+#define MATRIX_MAX_CPUS 32
+
+typedef struct {
+    int cpu;
+    volatile uint64_t* word;
+    // Written by the worker, read by the reporting thread.
+    volatile long long writes;
+    char padding[LINE];
+} CoherenceWorker;
+
+typedef struct {
+    int cpu;
+    volatile long* flag;
+    int first;
+    long long ns;
+} PingPong;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void request_stop(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static void pin(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+}
+
+static int package_of(int cpu) {
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    long long id = read_value(path);
+    return id >= 0 ? (int)id : 0;
+}
+
+// Lists the CPUs this process may run on, one socket after the other, or
+// alternating between sockets if [scatter]. Returns how many there are.
+static int list_cpus(int* cpus, bool scatter) {
+    cpu_set_t set;
+    if(sched_getaffinity(0, sizeof(set), &set) != 0) {
+        return 0;
+    }
+    int count = 0, packages = 0;
+    int allowed[CPU_SETSIZE], package[CPU_SETSIZE];
+    for(int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if(CPU_ISSET(cpu, &set)) {
+            allowed[count] = cpu;
+            package[count] = package_of(cpu);
+            packages = package[count] + 1 > packages ? package[count] + 1 : packages;
+            count++;
+        }
+    }
+    int n = 0;
+    if(scatter) {
+        // Take the next CPU of each socket in turn.
+        int* next = calloc(packages, sizeof(int));
+        if(next == NULL) {
+            return 0;
+        }
+        while(n < count) {
+            for(int p = 0; p < packages; p++) {
+                while(next[p] < count && package[next[p]] != p) {
+                    next[p]++;
+                }
+                if(next[p] < count) {
+                    cpus[n++] = allowed[next[p]++];
+                }
+            }
+        }
+        free(next);
+    } else {
+        for(int p = 0; p < packages; p++) {
+            for(int i = 0; i < count; i++) {
+                if(package[i] == p) {
+                    cpus[n++] = allowed[i];
+                }
+            }
+        }
+    }
+    return n;
+}
+
+static void* write_line(void* arg) {
+    CoherenceWorker* w = arg;
+    pin(w->cpu);
+    while(!stop_requested) {
+        for(int i = 0; i < WRITE_BATCH; i++) {
+            (*w->word)++;
+        }
+        w->writes += WRITE_BATCH;
+    }
+    return NULL;
+}
+
+// Bounces [flag] with the other side: the first side waits for even values,
+// the second for odd ones, and each increments it in turn. Sets the elapsed
+// time to -1 if interrupted.
+static void* ping_pong(void* arg) {
+    PingPong* p = arg;
+    pin(p->cpu);
+    long wait = p->first ? 0 : 1;
+    long long start = now_ns();
+    for(long i = 0; i < PING_PONGS; i++, wait += 2) {
+        while(__atomic_load_n(p->flag, __ATOMIC_ACQUIRE) != wait) {
+            if(stop_requested) {
+                p->ns = -1;
+                return NULL;
+            }
+        }
+        __atomic_store_n(p->flag, wait + 1, __ATOMIC_RELEASE);
+    }
+    p->ns = now_ns() - start;
+    return NULL;
+}
+
+// Returns the one-way latency in nanoseconds of moving a cache line between
+// CPUs [a] and [b], or -1 if the thread could not be started or the run was
+// interrupted. The calling thread plays [b], and stays pinned to it.
+static double transfer_ns(int a, int b, volatile long* flag) {
+    *flag = 0;
+    PingPong sides[2] = {{a, flag, 1, 0}, {b, flag, 0, 0}};
+    pthread_t thread;
+    if(pthread_create(&thread, NULL, ping_pong, &sides[0]) != 0) {
+        return -1;
+    }
+    ping_pong(&sides[1]);
+    pthread_join(thread, NULL);
+    return sides[0].ns < 0 ? -1 : (double)sides[0].ns / PING_PONGS / 2;
+}
+
+static void print_matrix(const int* cpus, int count) {
+    if(count > MATRIX_MAX_CPUS) {
+        count = MATRIX_MAX_CPUS;
+    }
+    volatile long* flag;
+    if(count < 2 || posix_memalign((void**)&flag, LINE, LINE) != 0) {
+        return;
+    }
+    printf("\nOne-way cache line transfer latency (ns), from row to column CPU:\n%6s", "");
+    for(int j = 0; j < count; j++) {
+        printf("  %6d", cpus[j]);
+    }
+    printf("\n");
+    for(int i = 0; i < count && !stop_requested; i++) {
+        printf("%6d", cpus[i]);
+        for(int j = 0; j < count && !stop_requested; j++) {
+            if(i == j) {
+                printf("  %6s", "-");
+            } else {
+                printf("  %6.1f", transfer_ns(cpus[i], cpus[j], flag));
+            }
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+    free((void*)flag);
+}
+
+int eat_coherence(int threads, int sharing, bool scatter, int timeout) {
+    int* cpus = malloc(sizeof(int) * CPU_SETSIZE);
+    int cpu_count = cpus ? list_cpus(cpus, scatter) : 0;
+    if(cpu_count == 0) {
+        printf("ERROR: Could not list the CPUs\n");
+        free(cpus);
+        return 1;
+    }
+    if(threads == 0) {
+        threads = cpu_count;
+    }
+    int lines = (threads + sharing - 1) / sharing;
+    CoherenceWorker* workers = calloc(threads, sizeof(CoherenceWorker));
+    pthread_t* ids = calloc(threads, sizeof(pthread_t));
+    long long* last = calloc(threads, sizeof(long long));
+    char* region;
+    if(workers == NULL || ids == NULL || last == NULL || posix_memalign((void**)&region, LINE, (size_t)lines * LINE) != 0) {
+        printf("ERROR: Could not allocate the workers\n");
+        return 1;
+    }
+    memset(region, 0, (size_t)lines * LINE);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = request_stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    printf("%d threads on %d CPUs, %d per cache line, %d lines\n", threads, cpu_count < threads ? cpu_count : threads, sharing, lines);
+    int count = threads;
+    for(int i = 0; i < threads; i++) {
+        workers[i].cpu = cpus[i % cpu_count];
+        // Members of a line write neighbouring words of it.
+        workers[i].word = (volatile uint64_t*)(region + (i / sharing) * LINE) + i % sharing;
+        if(pthread_create(&ids[i], NULL, write_line, &workers[i]) != 0) {
+            printf("ERROR: Could not start the workers\n");
+            stop_requested = 1;
+            count = i;
+            break;
+        }
+    }
+
+    long long start = now_ns(), last_report = start;
+    long long deadline = timeout >= 0 ? start + timeout * 1000000000LL : -1;
+    double total_writes = 0;
+    printf("%8s  %16s  %16s  %16s\n", "TIME_S", "TOTAL_WRITES/S", "MIN_THREAD/S", "MAX_THREAD/S");
+    while(!stop_requested && (deadline < 0 || now_ns() < deadline)) {
+        long long wait = REPORT_INTERVAL_NS;
+        if(deadline >= 0 && deadline - now_ns() < wait) {
+            wait = deadline - now_ns();
+        }
+        sleep_ns(wait, &stop_requested);
+        long long now = now_ns();
+        double secs = (now - last_report) / 1e9;
+        double total = 0, low = -1, high = 0;
+        for(int i = 0; i < count; i++) {
+            long long writes = workers[i].writes;
+            double rate = (writes - last[i]) / secs;
+            total += rate;
+            low = low < 0 || rate < low ? rate : low;
+            high = rate > high ? rate : high;
+            total_writes += writes - last[i];
+            last[i] = writes;
+        }
+        last_report = now;
+        printf("%8.1f  %16.4g  %16.4g  %16.4g\n", (now - start) / 1e9, total, low, high);
+        fflush(stdout);
+    }
+    stop_requested = 1;
+    for(int i = 0; i < count; i++) {
+        pthread_join(ids[i], NULL);
+    }
+    if(last_report > start) {
+        printf("Average %.4g writes/s over %.1f s\n", total_writes / ((last_report - start) / 1e9), (last_report - start) / 1e9);
+    }
+    // A second interrupt stops the matrix.
+    stop_requested = 0;
+    print_matrix(cpus, cpu_count < threads ? cpu_count : threads);
+    free(region);
+    free(last);
+    free(ids);
+    free(workers);
+    free(cpus);
+    return 0;
+}
+
+#endif
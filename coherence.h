@@ -0,0 +1,23 @@
+#ifndef coherence_h
+#define coherence_h
+
+#include <stdbool.h>
+
+#ifdef __linux__
+#define COHERENCE_MODE
+#endif
+
+#ifdef COHERENCE_MODE
+
+// Starts [threads] threads (0 for one per CPU), each pinned to a CPU and
+// writing its own word of a cache line shared with [sharing] - 1 others, so
+// the line bounces between their caches. CPUs are taken one socket at a
+// time, or alternating between sockets if [scatter]. Reports the writes per
+// second every second for [timeout] seconds, or until interrupted if
+// negative, then the one-way cache line transfer latency between every pair
+// of the CPUs used (up to 32). Returns the process exit code.
+int eat_coherence(int threads, int sharing, bool scatter, int timeout);
+
+#endif
+
+#endif
@@ -0,0 +1,168 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "cow.h"
+#include "util.h"
+
+typedef struct {
+    long long ns;
+    long faults;
+    long pages;
+} WriteResult;
+
+static long minor_faults() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+}
+
+static WriteResult write_pages(char* base, long total, double fraction) {
+    WriteResult result = {0, 0, 0};
+    long faults = minor_faults();
+    long long start = now_ns();
+    result.pages = touch_fraction(base, total, fraction);
+    result.ns = now_ns() - start;
+    result.faults = minor_faults() - faults;
+    return result;
+}
+
+static void print_writes(const char* who, WriteResult r) {
+    double secs = r.ns / 1e9;
+    printf("  %-9s wrote %ld pages, %ld faults in %.1f ms (%.0f faults/s)\n",
+        who, r.pages, r.faults, r.ns / 1e6, secs > 0 ? r.faults / secs : 0);
+}
+
+// Kills and reaps the first [count] children and closes their result pipes.
+static void stop_children(pid_t* pids, int* result_fds, int count) {
+    for(int i = 0; i < count; i++) {
+        kill(pids[i], SIGKILL);
+        while(waitpid(pids[i], NULL, 0) < 0 && errno == EINTR);
+        close(result_fds[i]);
+    }
+}
+
+static int run_cow(long total, int children, double fraction, int writers, bool thp) {
+    char* base = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(base == MAP_FAILED) {
+        printf("ERROR: Could not allocate the memory\n");
+        return 1;
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(base, total, thp ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+#endif
+    memset(base, 1, total);
+
+    printf("THP %s:\n", thp ? "on" : "off");
+    long long anon_before = read_keyed_value("/proc/meminfo", "AnonPages");
+
+    pid_t* pids = calloc(children, sizeof(pid_t));
+    int* result_fds = calloc(children, sizeof(int));
+    int start_fds[2];
+    if(pids == NULL || result_fds == NULL || pipe(start_fds) != 0) {
+        printf("ERROR: Could not set up the children\n");
+        free(result_fds);
+        free(pids);
+        munmap(base, total);
+        return 1;
+    }
+
+    long long fork_min = -1, fork_max = 0, fork_sum = 0;
+    fflush(stdout);
+    for(int i = 0; i < children; i++) {
+        int fds[2];
+        bool piped = pipe(fds) == 0;
+        long long start = now_ns();
+        pid_t pid = piped ? fork() : -1;
+        long long elapsed = now_ns() - start;
+        if(pid < 0) {
+            perror(piped ? "fork" : "pipe");
+            if(piped) {
+                close(fds[0]);
+                close(fds[1]);
+            }
+            close(start_fds[0]);
+            close(start_fds[1]);
+            stop_children(pids, result_fds, i);
+            free(result_fds);
+            free(pids);
+            munmap(base, total);
+            return 1;
+        }
+        if(pid == 0) {
+            char c;
+            close(start_fds[1]);
+            close(fds[0]);
+            // Block until the parent closes the start pipe so every child
+            // starts writing at the same time.
+            while(read(start_fds[0], &c, 1) < 0 && errno == EINTR);
+            WriteResult r = {0, 0, 0};
+            if(writers & COW_CHILDREN) {
+                r = write_pages(base, total, fraction);
+            }
+            if(write(fds[1], &r, sizeof(r)) != sizeof(r)) {
+                _exit(1);
+            }
+            while(true) {
+                pause();
+            }
+        }
+        close(fds[1]);
+        pids[i] = pid;
+        result_fds[i] = fds[0];
+        fork_sum += elapsed;
+        fork_min = fork_min < 0 || elapsed < fork_min ? elapsed : fork_min;
+        fork_max = elapsed > fork_max ? elapsed : fork_max;
+    }
+    printf("  fork      avg %.3f ms, min %.3f ms, max %.3f ms\n",
+        fork_sum / 1e6 / children, fork_min / 1e6, fork_max / 1e6);
+
+    close(start_fds[0]);
+    close(start_fds[1]);
+    if(writers & COW_PARENT) {
+        print_writes("parent", write_pages(base, total, fraction));
+    }
+
+    WriteResult sum = {0, 0, 0};
+    for(int i = 0; i < children; i++) {
+        WriteResult r;
+        if(read(result_fds[i], &r, sizeof(r)) == sizeof(r)) {
+            sum.ns = r.ns > sum.ns ? r.ns : sum.ns;
+            sum.faults += r.faults;
+            sum.pages += r.pages;
+        }
+    }
+    if(writers & COW_CHILDREN) {
+        print_writes("children", sum);
+    }
+
+    long long anon_after = read_keyed_value("/proc/meminfo", "AnonPages");
+    if(anon_before >= 0 && anon_after >= 0) {
+        printf("  extra RSS %lld kB (AnonPages delta)\n", anon_after - anon_before);
+    }
+
+    stop_children(pids, result_fds, children);
+    free(result_fds);
+    free(pids);
+    munmap(base, total);
+    return 0;
+}
+
+int eat_cow(long total, int children, double fraction, int writers) {
+    int status = run_cow(total, children, fraction, writers, false);
+#ifdef MADV_HUGEPAGE
+    if(status == 0) {
+        status = run_cow(total, children, fraction, writers, true);
+    }
+#endif
+    return status;
+}
@@ -0,0 +1,15 @@
+#ifndef cow_h
+#define cow_h
+
+#define COW_PARENT 1
+#define COW_CHILDREN 2
+
+// Fills a [total] byte region, forks [children] processes that share it and
+// then writes to [fraction] of its pages from the parent and/or the children
+// ([writers] is a mask of COW_PARENT and COW_CHILDREN). Reports fork latency,
+// copy-on-write fault rate and the extra anonymous memory the copies cost,
+// once without and once with transparent huge pages where available.
+// Returns the process exit code.
+int eat_cow(long total, int children, double fraction, int writers);
+
+#endif
@@ -0,0 +1,101 @@
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "eat.h"
+#include "kernel.h"
+
+short** eat(long total,int chunk){
+	long i;
+    short** allocations = malloc(sizeof(short*) * ((total+chunk-1)/chunk));
+    if(allocations==NULL){
+        return NULL;
+    }
+	for(i=0;i<total;i+=chunk){
+		short *buffer=malloc(sizeof(char)*chunk);
+        if(buffer==NULL){
+            digest(allocations, i, chunk);
+            free(allocations);
+            return NULL;
+        }
+		kernel_fill((char*)buffer,chunk,0);
+        allocations[i/chunk] = buffer;
+	}
+    return allocations;
+}
+
+void digest(short** eaten, long total,int chunk) {
+    long i;
+    for(i=0;i<total;i+=chunk){
+        free(eaten[i/chunk]);
+    }
+}
+
+void extents_init(Extents* extents) {
+    extents->bases = NULL;
+    extents->sizes = NULL;
+    extents->count = 0;
+    extents->capacity = 0;
+    extents->total = 0;
+}
+
+bool extents_grow(Extents* extents, long size) {
+    if(extents->count == extents->capacity) {
+        long capacity = extents->capacity < 16 ? 16 : extents->capacity * 2;
+        char** bases = realloc(extents->bases, sizeof(char*) * capacity);
+        if(bases == NULL) {
+            return false;
+        }
+        extents->bases = bases;
+        long* sizes = realloc(extents->sizes, sizeof(long) * capacity);
+        if(sizes == NULL) {
+            return false;
+        }
+        extents->sizes = sizes;
+        extents->capacity = capacity;
+    }
+    char* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(base == MAP_FAILED) {
+        return false;
+    }
+    kernel_fill(base, size, 0);
+    extents->bases[extents->count] = base;
+    extents->sizes[extents->count++] = size;
+    extents->total += size;
+    return true;
+}
+
+void extents_shrink(Extents* extents) {
+    if(extents->count > 0) {
+        extents->count--;
+        munmap(extents->bases[extents->count], extents->sizes[extents->count]);
+        extents->total -= extents->sizes[extents->count];
+    }
+}
+
+void extents_truncate(Extents* extents, long size) {
+    long page = sysconf(_SC_PAGE_SIZE);
+    while(extents->count > 0 && extents->total > size) {
+        long last = extents->sizes[extents->count - 1];
+        long keep = (last - (extents->total - size)) / page * page;
+        if(keep <= 0) {
+            extents_shrink(extents);
+        } else {
+            munmap(extents->bases[extents->count - 1] + keep, last - keep);
+            extents->sizes[extents->count - 1] = keep;
+            extents->total -= last - keep;
+            break;
+        }
+    }
+}
+
+void extents_free(Extents* extents) {
+    while(extents->count > 0) {
+        extents_shrink(extents);
+    }
+    free(extents->bases);
+    free(extents->sizes);
+    extents_init(extents);
+}
@@ -0,0 +1,42 @@
+#ifndef eat_h
+#define eat_h
+
+#include <stdbool.h>
+
+// Largest mapping extents_grow() is asked for at once.
+#define EXTENT_SIZE (64L * 1024 * 1024)
+
+// Memory eaten as a list of anonymous mappings of up to EXTENT_SIZE bytes.
+typedef struct {
+    char** bases;
+    long* sizes;
+    long count;
+    long capacity;
+    long total;
+} Extents;
+
+// Allocates [total] bytes in [chunk]-sized blocks and touches every byte.
+// Returns the array of blocks, or NULL if an allocation failed.
+short** eat(long total, int chunk);
+
+// Frees the blocks returned by eat().
+void digest(short** eaten, long total, int chunk);
+
+// Initializes an empty list of extents.
+void extents_init(Extents* extents);
+
+// Maps one more extent of [size] bytes and touches every byte. Returns false
+// if the mapping failed.
+bool extents_grow(Extents* extents, long size);
+
+// Unmaps the most recently added extent.
+void extents_shrink(Extents* extents);
+
+// Unmaps the tail of the extents until at most [size] bytes are left,
+// trimming the last extent to a page boundary instead of dropping it whole.
+void extents_truncate(Extents* extents, long size);
+
+// Unmaps every extent and frees the list.
+void extents_free(Extents* extents);
+
+#endif
@@ -5,145 +5,1272 @@
  * Created on August 27, 2012, 2:23 PM
  */
 
-#define VERSION "0.1.10"
-
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
+#include <errno.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <signal.h>
 #include "args/args.h"
+#include "eatmemory.h"
+#include "handle.h"
+#include "eat.h"
+#include "procs.h"
+#include "cow.h"
+#include "pagecache.h"
+#include "shmem.h"
+#include "churn.h"
+#include "bench.h"
+#include "reserve.h"
+#include "release.h"
+#include "probe.h"
+#include "ramp.h"
+#include "scenario.h"
+#include "kernel.h"
+#include "fill.h"
+#include "victim.h"
+#include "coherence.h"
+#include "loop.h"
+#include "precise.h"
+#include "kmem.h"
+#include "cache.h"
+#include "tlb.h"
+#include "sparse.h"
+#include "perf.h"
+#include "inspect.h"
+#include "verify.h"
+#include "util.h"
 
-#if defined(_SC_PHYS_PAGES) && defined(_SC_AVPHYS_PAGES) && defined(_SC_PAGE_SIZE)
-#define MEMORY_PERCENTAGE
-#endif
+// Options shared by several commands, each registered only by the commands
+// that use it.
+#define COMMON_TIMEOUT 1
+#define COMMON_FAST_EXIT 2
+#define COMMON_KERNEL 4
+#define COMMON_FILL 8
+#define COMMON_ALL (COMMON_TIMEOUT | COMMON_FAST_EXIT | COMMON_KERNEL | COMMON_FILL)
 
-#ifdef MEMORY_PERCENTAGE
-size_t getTotalSystemMemory(){
-    long pages = sysconf(_SC_PHYS_PAGES);
-    long page_size = sysconf(_SC_PAGE_SIZE);
-    return pages * page_size;
+// Registers the COMMON_* options in the mask [opts].
+void add_common_opts(ArgParser* parser, int opts) {
+    if(opts & COMMON_TIMEOUT) {
+        ap_add_int_opt(parser, "timeout t", -1);
+    }
+    if(opts & COMMON_FAST_EXIT) {
+        ap_add_flag(parser, "fast-exit");
+    }
+    if(opts & COMMON_KERNEL) {
+        ap_add_str_opt(parser, "kernel", "auto");
+    }
+    if(opts & COMMON_FILL) {
+        ap_add_str_opt(parser, "fill", "store");
+    }
 }
 
-size_t getFreeSystemMemory(){
-    long pages = sysconf(_SC_AVPHYS_PAGES);
-    long page_size = sysconf(_SC_PAGE_SIZE);
-    return pages * page_size;
+void add_victim_opts(ArgParser* parser) {
+    ap_add_flag(parser, "victim");
+    ap_add_str_opt(parser, "victim-size", "1M");
 }
+
+// Options of the hold command, which is also what eatmemory <size> runs.
+void add_hold_opts(ArgParser* parser) {
+    add_common_opts(parser, COMMON_ALL);
+    ap_add_str_opt(parser, "release", "free");
+    ap_add_int_opt(parser, "release-threads", 1);
+    ap_add_flag(parser, "verify");
+    ap_add_int_opt(parser, "verify-interval", 0);
+    ap_add_int_opt(parser, "seed", 1);
+    ap_add_flag(parser, "perf");
+    ap_add_int_opt(parser, "sample", 0);
+    ap_add_dbl_opt(parser, "precise", 0);
+    ap_add_str_opt(parser, "precise-measure", "rss");
+    ap_add_str_opt(parser, "kind", "anon");
+    add_victim_opts(parser);
+#ifdef INSPECT
+    ap_add_flag(parser, "inspect");
 #endif
+#ifdef SHMEM_BACKING
+    ap_add_str_opt(parser, "backing", "anon");
+    ap_add_flag(parser, "hugetlb");
+    ap_add_flag(parser, "seal");
+    ap_add_str_opt(parser, "shmem-exec", NULL);
+#endif
+}
 
-ArgParser* configure_cmd() {
-    ArgParser* parser = ap_new_parser();
-    ap_add_flag(parser, "help h ?");
-    ap_add_int_opt(parser, "timeout t", -1);
-    return parser;
+void add_procs_opts(ArgParser* parser) {
+    ap_add_int_opt(parser, "oom-score-adj", 0);
+    ap_add_str_opt(parser, "timeline", NULL);
+}
+
+void add_cow_opts(ArgParser* parser) {
+    ap_add_dbl_opt(parser, "cow-fraction", 0.5);
+    ap_add_str_opt(parser, "cow-writers", "both");
+}
+
+void add_page_cache_opts(ArgParser* parser) {
+    ap_add_str_opt(parser, "page-cache-method", "read");
+    ap_add_int_opt(parser, "reread", 5);
+}
+
+void add_probe_opts(ArgParser* parser) {
+    ap_add_dbl_opt(parser, "psi-limit", 10);
+    ap_add_dbl_opt(parser, "backoff", 5);
+}
+
+void add_reserve_opts(ArgParser* parser) {
+    ap_add_flag(parser, "noreserve");
+    ap_add_dbl_opt(parser, "touch-fraction", 0);
+}
+
+void add_sparse_opts(ArgParser* parser) {
+    ap_add_str_opt(parser, "stride", "2M");
+    ap_add_flag(parser, "write");
+}
+
+void add_bench_opts(ArgParser* parser) {
+    ap_add_int_opt(parser, "repeat", 5);
+    ap_add_str_opt(parser, "json", NULL);
+}
+
+void add_churn_opts(ArgParser* parser) {
+    ap_add_str_opt(parser, "sizes", "16:40,32:20,64:15,128:10,256:6,1024:5,4096:3,65536:1");
+    ap_add_int_opt(parser, "lifetime", 1000);
 }
 
 void print_help() {
-    printf("eatmemory %s - %s\n\n", VERSION, "https://github.com/julman99/eatmemory");
+    printf("eatmemory %s - %s\n\n", EATMEMORY_VERSION, "https://github.com/julman99/eatmemory");
     printf("Usage: eatmemory [-t <seconds>] <size>\n");
+    printf("       eatmemory <command> [options] <size>\n");
+#ifdef CACHE_MODE
+    printf("       eatmemory [-t <seconds>] --cache <fraction> [--cache-pin <core|socket>]\n");
+#endif
+    printf("Commands: hold (default), run, ramp, probe, bench, churn, cow, page-cache,\n");
+    printf("          procs, reserve, sparse, kernels, fill, tlb");
+#ifdef INSPECT
+    printf(", inspect");
+#endif
+#ifdef CACHE_MODE
+    printf(", cache");
+#endif
+#ifdef COHERENCE_MODE
+    printf(", coherence");
+#endif
+    printf("\n");
+    printf("Run 'eatmemory help <command>' for the options of a command.\n\n");
     printf("Size can be specified in megabytes or gigabytes in the following way:\n");
     printf("#             # Bytes      example: 1024\n");
     printf("#M            # Megabytes  example: 15M\n");
     printf("#G            # Gigabytes  example: 2G\n");
-#ifdef MEMORY_PERCENTAGE
-    printf("#%%           # Percent    example: 50%%\n");
-#endif
+    if(em_free_system_memory() >= 0) {
+        printf("#%%           # Percent    example: 50%%\n");
+    }
     printf("\n");
     printf("Options:\n");
     printf("-t <seconds>  Exit after specified number of seconds\n");
+    printf("--procs <n>   Split the memory across n worker processes and report\n");
+    printf("              which of them get OOM-killed, and when\n");
+    printf("--oom-score-adj <adj>\n");
+    printf("              oom_score_adj of the next worker, repeat once per worker\n");
+    printf("--timeline <file>\n");
+    printf("              Also write the worker timeline to file as CSV\n");
+    printf("--cow <k>     Fill the memory, fork k children sharing it and measure\n");
+    printf("              fork latency and copy-on-write faults, then exit\n");
+    printf("--cow-fraction <f>\n");
+    printf("              Fraction of pages written after the fork (default 0.5)\n");
+    printf("--cow-writers <parent|children|both>\n");
+    printf("              Who writes to the pages after the fork (default both)\n");
+    printf("--page-cache <file>\n");
+    printf("              Fill the page cache with a new scratch file instead of\n");
+    printf("              anonymous memory and keep it hot; the file must not\n");
+    printf("              exist and is removed on exit\n");
+    printf("--page-cache-method <read|mmap>\n");
+    printf("              Keep the file hot with buffered reads or through a\n");
+    printf("              shared mapping (default read)\n");
+    printf("--reread <seconds>\n");
+    printf("              Seconds between re-reads of the scratch file (default 5)\n");
+    printf("--tlb         Touch one cache line per page in random order and report\n");
+    printf("              the cost per access with small and huge pages, then exit\n");
+    printf("--probe       Find the largest amount of memory, up to size, that can\n");
+    printf("              reliably be held, hold it for -t seconds (default 2)\n");
+    printf("              and exit\n");
+    printf("--psi-limit <percent>\n");
+    printf("              Memory stall share that stops a --probe step (default 10)\n");
+    printf("--backoff <percent>\n");
+    printf("              How far --probe backs off from the peak (default 5)\n");
+    printf("--verify      Fill the memory with a pattern derived from the seed and\n");
+    printf("              each page's address, and check it before releasing it\n");
+    printf("--verify-interval <seconds>\n");
+    printf("              Also check it periodically while holding it\n");
+    printf("--seed <n>    Seed of the --verify pattern (default 1)\n");
+    printf("--perf        Report perf counters (faults, dTLB and LLC misses, cycles,\n");
+    printf("              instructions) for filling and releasing the memory\n");
+    printf("--sample <seconds>\n");
+    printf("              Report the RSS, cgroup usage and memory stall every\n");
+    printf("              seconds while holding the memory\n");
+    printf("--precise <percent>\n");
+    printf("              Once the memory is eaten, grow or shrink it until the\n");
+    printf("              measured memory is within percent of the size\n");
+    printf("--precise-measure <rss|cgroup>\n");
+    printf("              What --precise measures: the RSS of the process\n");
+    printf("              (default) or the memory charged to its cgroup\n");
+    printf("--kind <anon|kernel>\n");
+    printf("              Eat anonymous memory (default) or unreclaimable kernel\n");
+    printf("              memory held in unread pipe and socket buffers\n");
+    printf("--victim      Run hash lookups on another CPU and report their p50 and\n");
+    printf("              p99 latency before, during and after each phase\n");
+    printf("--victim-size <size>\n");
+    printf("              Working set of the --victim lookups (default 1M)\n");
+#ifdef INSPECT
+    printf("--inspect     Report what backs the memory once it is eaten: physical\n");
+    printf("              contiguity, huge pages, zero pages, swap and KSM\n");
+#endif
+    printf("--release <free|munmap|dontneed|madv-free>\n");
+    printf("              How to release the memory: free the chunks one by one\n");
+    printf("              (default), or map it in extents and release them with\n");
+    printf("              munmap, MADV_DONTNEED or MADV_FREE\n");
+    printf("--release-threads <n>\n");
+    printf("              Release the memory from n threads (default 1)\n");
+    printf("--fast-exit   Exit right away on SIGTERM or SIGINT, even as PID 1 in a\n");
+    printf("              container, and skip releasing the memory\n");
+    printf("--kernel <auto|scalar|sse2|avx2|avx512|neon>\n");
+    printf("              Instruction set used to fill the memory (default auto,\n");
+    printf("              the fastest this CPU supports)\n");
+    printf("--fill <store|stream|stosb>\n");
+    printf("              Fill the memory with ordinary stores (default), with\n");
+    printf("              non-temporal stores that bypass the caches, or with\n");
+    printf("              rep stosb\n");
+    printf("--reserve-only\n");
+    printf("              Map the memory without touching it, consuming commit\n");
+    printf("              charge but not RAM\n");
+    printf("--noreserve   Map the --reserve-only memory with MAP_NORESERVE\n");
+    printf("--touch-fraction <f>\n");
+    printf("              Fraction of the --reserve-only pages to touch (default 0)\n");
+    printf("--sparse      Reserve size bytes of address space and read one page\n");
+    printf("              per stride, consuming almost only page tables\n");
+    printf("--stride <size>\n");
+    printf("              Distance between --sparse touches (default 2M)\n");
+    printf("--write       Write the --sparse pages instead, so each one also takes\n");
+    printf("              a page of RAM\n");
+    printf("--bench       Compare how fast each allocation strategy fills the\n");
+    printf("              memory, then exit\n");
+    printf("--repeat <n>  Runs per strategy for --bench (default 5)\n");
+    printf("--json <file> Also write the --bench results to file as JSON\n");
+    printf("--churn       Keep size as live heap while allocating and freeing\n");
+    printf("              objects, and report allocator throughput and bloat\n");
+    printf("--sizes <size:weight,...>\n");
+    printf("              Object size distribution for --churn\n");
+    printf("--lifetime <steps>\n");
+    printf("              Average object lifetime for --churn (default 1000)\n");
+#ifdef CACHE_MODE
+    printf("--cache <fraction>\n");
+    printf("              Instead of eating memory, keep fraction of each last-level\n");
+    printf("              cache occupied and report the access rate\n");
+    printf("--cache-pin <core|socket>\n");
+    printf("              Run one --cache worker per core or per cache (default socket)\n");
+#endif
+#ifdef SHMEM_BACKING
+    printf("--backing <anon|shmem>\n");
+    printf("              Eat private anonymous memory or a memfd (default anon)\n");
+    printf("--hugetlb     Back the memfd with hugetlbfs pages\n");
+    printf("--seal        Seal the size of the memfd\n");
+    printf("--shmem-exec <command>\n");
+    printf("              Run command with the memfd inherited, its number is in\n");
+    printf("              EATMEMORY_SHMEM_FD, and wait for it before holding\n");
+#endif
+    printf("\n");
+}
+
+void fast_exit(int sig) {
+    (void)sig;
+    _exit(0);
+}
+
+#ifdef INSPECT
+void inspect_chunks(short** eaten, long total, int chunk) {
+    char* low = (char*)eaten[0];
+    char* high = low;
+    for(long i = 0; i < (total + chunk - 1) / chunk; i++) {
+        char* p = (char*)eaten[i];
+        low = p < low ? p : low;
+        high = p > high ? p : high;
+    }
+    InspectStats stats;
+    inspect_init(&stats);
+    printf("\nInspecting the heap span of the chunks (%ld bytes)...\n", (long)(high + chunk - low));
+    if(inspect_range(&stats, low, high + chunk - low)) {
+        inspect_print(&stats);
+    }
     printf("\n");
 }
 
-short** eat(long total,int chunk){
-	long i;
-    short** allocations = malloc(sizeof(short*) * (total/chunk));
-	for(i=0;i<total;i+=chunk){
-		short *buffer=malloc(sizeof(char)*chunk);
-        if(buffer==NULL){
-            return NULL;
+void inspect_extents(Extents* extents) {
+    InspectStats stats;
+    inspect_init(&stats);
+    printf("\nInspecting %ld extents...\n", extents->count);
+    for(long i = 0; i < extents->count; i++) {
+        if(!inspect_range(&stats, extents->bases[i], extents->sizes[i])) {
+            return;
         }
-		memset(buffer,0,chunk);
-        allocations[i/chunk] = buffer;
-	}
-    return allocations;
+    }
+    inspect_print(&stats);
+    printf("\n");
+}
+#endif
+
+// What the memory is held for, shared with the callbacks of the loop that
+// holds it.
+typedef struct {
+    EatMemory* em;
+    KernelMemory* kmem;
+    long long start;
+    bool verify;
+    uint64_t seed;
+    bool verified;
+    int stdin_id;
+    char line[256];
+    size_t line_len;
+} Holder;
+
+void on_deadline(Loop* loop, void* data) {
+    (void)data;
+    loop_stop(loop);
+}
+
+void on_verify(Loop* loop, void* data) {
+    (void)loop;
+    Holder* holder = data;
+    holder->verified = verify_extents(&holder->em->extents, holder->seed) && holder->verified;
 }
 
-void digest(short** eaten, long total,int chunk) {
-    long i;
-    for(i=0;i<total;i+=chunk){
-        free(eaten[i/chunk]);
+void on_sample(Loop* loop, void* data) {
+    (void)loop;
+    Holder* holder = data;
+    long long usage = cgroup_memory_usage();
+    long long stall = memory_stall_us();
+    printf("%8.1f s  RSS %lld kB", (now_ns() - holder->start) / 1e9, rss_bytes() / 1024);
+    if(usage >= 0) {
+        printf(", cgroup %lld kB", usage / 1024);
+    }
+    if(stall >= 0) {
+        printf(", memory stall %.1f ms total", stall / 1e3);
     }
+    if(holder->kmem != NULL) {
+        KernelUsage kernel;
+        kernel_usage(&kernel);
+        printf(", SUnreclaim %lld kB", kernel.unreclaimable / 1024);
+    }
+    printf("\n");
+    fflush(stdout);
 }
 
-int main(int argc, char *argv[]){
+// Grows or shrinks the held memory, writing the --verify pattern to extents
+// that were added.
+void resize_held(Holder* holder, const char* command, const char* size_text) {
+    long long size = size_text ? em_parse_size(size_text) : -1;
+    if(holder->em == NULL && holder->kmem == NULL) {
+        printf("ERROR: This memory can't be grown or shrunk\n");
+        return;
+    } else if(size <= 0) {
+        printf("ERROR: Usage: grow <size> | shrink <size>\n");
+        return;
+    }
+    bool grow = strcmp(command, "grow") == 0;
+    if(holder->kmem != NULL) {
+        if(grow && kmem_grow(holder->kmem, size) != 0) {
+            printf("ERROR: Could not allocate the memory\n");
+        } else if(!grow) {
+            kmem_shrink(holder->kmem, size);
+        }
+        printf("Holding %lld bytes\n", holder->kmem->size);
+        return;
+    }
+    long count = holder->em->extents.count;
+    if(grow && em_grow(holder->em, size) != 0) {
+        printf("ERROR: Could not allocate the memory\n");
+    } else if(!grow) {
+        em_shrink(holder->em, size);
+    }
+    for(long i = count; holder->verify && i < holder->em->extents.count; i++) {
+        verify_fill(holder->em->extents.bases[i], holder->em->extents.sizes[i], holder->seed);
+    }
+    EatMemoryStats stats;
+    em_stats(holder->em, &stats);
+    printf("Holding %lld bytes\n", stats.size);
+}
 
-#ifdef MEMORY_PERCENTAGE
-    printf("Currently total memory: %zd\n",getTotalSystemMemory());
-    printf("Currently avail memory: %zd\n",getFreeSystemMemory());
-#endif
+// Handles control messages on stdin, one per line: an empty line or "quit"
+// frees the memory, "grow <size>" and "shrink <size>" change how much is held
+// and "stats" reports it. At end of file the memory stays held. A line split
+// across reads is kept in the holder until its newline arrives.
+void on_stdin(Loop* loop, void* data) {
+    Holder* holder = data;
+    ssize_t n = read(STDIN_FILENO, holder->line + holder->line_len, sizeof(holder->line) - 1 - holder->line_len);
+    if(n <= 0) {
+        loop_remove(loop, holder->stdin_id);
+        return;
+    }
+    holder->line_len += n;
+    holder->line[holder->line_len] = 0;
+    char* line = holder->line;
+    for(char* next; (next = strchr(line, '\n')) != NULL; line = next) {
+        *next++ = 0;
+        char* command = strtok(line, " \t\r");
+        if(command == NULL || strcmp(command, "quit") == 0) {
+            holder->line_len = 0;
+            loop_stop(loop);
+            return;
+        } else if(strcmp(command, "grow") == 0 || strcmp(command, "shrink") == 0) {
+            resize_held(holder, command, strtok(NULL, " \t\r"));
+        } else if(strcmp(command, "stats") == 0) {
+            on_sample(loop, holder);
+        } else {
+            printf("ERROR: Unknown command %s\n", command);
+        }
+        fflush(stdout);
+    }
+    holder->line_len = strlen(line);
+    if(holder->line_len == sizeof(holder->line) - 1) {
+        printf("ERROR: Command too long\n");
+        fflush(stdout);
+        holder->line_len = 0;
+    }
+    memmove(holder->line, line, holder->line_len);
+}
 
-    ArgParser* parser = configure_cmd();
-    ap_parse(parser, argc, argv);
-    if(ap_found(parser, "help")) {
-        print_help();
-        exit(0);
+// Holds the memory until [timeout] seconds pass, a SIGINT or SIGTERM arrives
+// or a quit message is read from stdin, without waking up unless there is
+// something to do. Every [verify_interval] seconds the --verify pattern of
+// [em] is checked, and every [sample] seconds the RSS is reported, if they
+// are positive. The memory can be grown or shrunk through [em] or, for kernel
+// memory, [kmem]; both are NULL if the memory was not eaten through either.
+// Returns false if the memory could not be held or a check failed.
+bool hold_memory(EatMemory* em, KernelMemory* kmem, int timeout, bool verify, int verify_interval, uint64_t seed, int sample) {
+    Holder holder = {em, kmem, now_ns(), verify, seed, true, -1, {0}, 0};
+    Loop* loop = loop_new();
+    if(loop == NULL) {
+        printf("ERROR: Could not set up the event loop\n");
+        return false;
     }
+    if(timeout >= 0) {
+        printf("Done, sleeping for %d seconds before exiting...\n", timeout);
+        loop_add_timer(loop, timeout * 1000000000LL, 0, on_deadline, &holder);
+    } else if(isatty(STDIN_FILENO)) {
+        printf("Done, press ENTER to free the memory\n");
+    } else {
+        printf("Done, send quit or an empty line on stdin or kill this process to free the memory\n");
+    }
+    if(verify && verify_interval > 0) {
+        printf("Verifying every %d seconds\n", verify_interval);
+        loop_add_timer(loop, verify_interval * 1000000000LL, verify_interval * 1000000000LL, on_verify, &holder);
+    }
+    if(sample > 0) {
+        loop_add_timer(loop, sample * 1000000000LL, sample * 1000000000LL, on_sample, &holder);
+    }
+    fflush(stdout);
+    holder.stdin_id = loop_add_fd(loop, STDIN_FILENO, on_stdin, &holder);
+    loop_run(loop);
+    loop_free(loop);
+    return holder.verified;
+}
+
+bool hold(int timeout) {
+    return hold_memory(NULL, NULL, timeout, false, 0, 0, 0);
+}
+
+// Returns the size given as the only positional argument of [parser],
+// printing the help and exiting if it is missing or invalid. Also installs
+// the --fast-exit handlers and selects the --kernel and --fill method, as
+// every command that eats memory calls it first.
+long size_arg(ArgParser* parser, int opts) {
     if(ap_count_args(parser) != 1) {
-        print_help();
+        if(ap_get_helptext(parser) != NULL) {
+            puts(ap_get_helptext(parser));
+        } else {
+            print_help();
+        }
+        exit(1);
+    }
+    long size=em_parse_size(ap_get_args(parser)[0]);
+    if(size < 0){
+        printf("Invalid size format\n");
+        exit(0);
+    }
+    if(size <=0 ) {
+        printf("ERROR: Size must be a positive integer");
         exit(1);
     }
+    if((opts & COMMON_FAST_EXIT) && ap_found(parser, "fast-exit")) {
+        signal(SIGTERM, fast_exit);
+        signal(SIGINT, fast_exit);
+    }
+    if(opts & COMMON_KERNEL) {
+        const Kernel* kernel = kernel_find(ap_get_str_value(parser, "kernel"));
+        if(kernel == NULL) {
+            printf("ERROR: Kernel %s is not available on this CPU", ap_get_str_value(parser, "kernel"));
+            exit(1);
+        }
+        kernel_use(kernel);
+    }
+    if(opts & COMMON_FILL) {
+        int fill = kernel_fill_method(ap_get_str_value(parser, "fill"));
+        if(fill < 0) {
+            printf("ERROR: Fill method %s is not available", ap_get_str_value(parser, "fill"));
+            exit(1);
+        }
+        kernel_use_fill(fill);
+    }
+    return size;
+}
 
-    int timeout = ap_get_int_value(parser, "timeout");
-    char* memory_to_eat = ap_get_args(parser)[0];
+// Starts the victim if --victim was given. Exits if it can't be started.
+Victim* start_victim(ArgParser* parser) {
+    if(!ap_found(parser, "victim")) {
+        return NULL;
+    }
+    long long working_set = em_parse_size(ap_get_str_value(parser, "victim-size"));
+    Victim* victim = working_set > 0 ? victim_start(working_set) : NULL;
+    if(victim == NULL) {
+        printf("ERROR: Could not start the victim");
+        exit(1);
+    }
+    return victim;
+}
+
+// Prints an error if any option in the NULL-terminated [names] was given, as
+// [mode] does not support it. [inspect] stands for --inspect, which can also
+// come from the inspect command. Returns true if there was one.
+bool reject_opts(ArgParser* parser, const char* mode, const char* names[], bool inspect) {
+    if(inspect) {
+        printf("ERROR: %s does not support --inspect", mode);
+        return true;
+    }
+    for(int i = 0; names[i] != NULL; i++) {
+        if(ap_found(parser, names[i])) {
+            printf("ERROR: %s does not support --%s", mode, names[i]);
+            return true;
+        }
+    }
+    return false;
+}
 
-    ap_free(parser);
+// Eats [size] bytes of kernel memory and holds it like anonymous memory,
+// reporting how the kernel's counters grew. Of the options of the hold
+// command only those that make sense for kernel memory are accepted.
+int run_kernel_memory(ArgParser* parser, long size, bool inspect) {
+    int timeout = ap_get_int_value(parser, "timeout");
+    bool fast = ap_found(parser, "fast-exit");
+    bool perf = ap_found(parser, "perf");
+    const char* unsupported[] = {
+        "verify", "verify-interval", "seed", "precise", "precise-measure", "release", "release-threads",
+#ifdef SHMEM_BACKING
+        "backing", "hugetlb", "seal", "shmem-exec",
+#endif
+        NULL
+    };
+    if(reject_opts(parser, "--kind kernel", unsupported, inspect)) {
+        return 1;
+    }
+    KernelMemory kmem;
+    KernelUsage before, after;
+    PerfCounters counters;
+    PerfPhase phases[2];
+    Victim* victim = start_victim(parser);
+    kmem_init(&kmem);
+    kernel_usage(&before);
+    printf("Eating %ld bytes of kernel memory in pipe and socket buffers...\n", size);
+    victim_phase(victim, "fill");
+    perf_begin(&counters, perf);
+    long long start = now_ns();
+    bool eaten = kmem_grow(&kmem, size) == 0;
+    perf_end(&counters, &phases[0], "fill");
+    if(!eaten) {
+        printf("ERROR: Could not allocate the memory after %lld bytes in %ld buffers: %s\n",
+               kmem.size, kmem.count, strerror(errno));
+        kmem_release(&kmem);
+        return 1;
+    }
+    printf("Eaten in %.1f ms, %ld buffers\n", (now_ns() - start) / 1e6, kmem.count);
+    kernel_usage(&after);
+    kernel_usage_print(&before, &after);
+    victim_phase(victim, "hold");
+    bool held = hold_memory(NULL, &kmem, timeout, false, 0, 0, ap_get_int_value(parser, "sample"));
+    if(fast) {
+        exit(0);
+    }
+    victim_phase(victim, "release");
+    perf_begin(&counters, perf);
+    long long released = kmem_release(&kmem);
+    perf_end(&counters, &phases[1], "release");
+    printf("Released in %.1f ms\n", released / 1e6);
+    victim_finish(victim);
+    if(perf) {
+        printf("\n");
+        perf_print(phases, 2);
+    }
+    return held ? 0 : 1;
+}
 
-    int len=strlen(memory_to_eat);
-    char unit=memory_to_eat[len - 1];
-    long size=-1;
+int run_hold(ArgParser* parser, long size, bool inspect) {
+    int timeout = ap_get_int_value(parser, "timeout");
+    bool fast = ap_found(parser, "fast-exit");
+    char* release = ap_get_str_value(parser, "release");
+    int release_threads = ap_get_int_value(parser, "release-threads");
+    bool verify = ap_found(parser, "verify");
+    int verify_interval = ap_get_int_value(parser, "verify-interval");
+    uint64_t seed = (uint64_t)ap_get_int_value(parser, "seed");
+    bool perf = ap_found(parser, "perf");
+    double precise = ap_get_dbl_value(parser, "precise");
+    int measure = precise_measure(ap_get_str_value(parser, "precise-measure"));
     int chunk=1024;
-    if(!isdigit(unit) ){
-        if(unit=='M' || unit=='G'){
-            memory_to_eat[len-1]=0;
-            size=atol(memory_to_eat) * (unit=='M'?1024*1024:1024*1024*1024);
+    char* kind = ap_get_str_value(parser, "kind");
+    if(strcmp(kind, "kernel") == 0) {
+        return run_kernel_memory(parser, size, inspect);
+    } else if(strcmp(kind, "anon") != 0) {
+        printf("ERROR: Invalid kind %s", kind);
+        return 1;
+    }
+#ifdef SHMEM_BACKING
+    char* backing = ap_get_str_value(parser, "backing");
+    if(strcmp(backing, "shmem") == 0) {
+        const char* unsupported[] = {
+            "verify", "verify-interval", "seed", "perf", "victim", "victim-size", "precise",
+            "precise-measure", "release", "release-threads", NULL
+        };
+        if(reject_opts(parser, "--backing shmem", unsupported, inspect)) {
+            return 1;
         }
-#ifdef MEMORY_PERCENTAGE
-        else if (unit=='%') {
-            size = (atol(memory_to_eat) * (long)getFreeSystemMemory())/100;
+        int shmem_flags = (ap_found(parser, "hugetlb") ? SHMEM_HUGETLB : 0) | (ap_found(parser, "seal") ? SHMEM_SEAL : 0);
+        char* shmem_exec_command = ap_get_str_value(parser, "shmem-exec");
+        Shmem shm;
+        printf("Eating %ld bytes of shared memory...\n",size);
+        if(!shmem_eat(&shm, size, shmem_flags)) {
+            printf("ERROR: Could not allocate the memory");
+            return 1;
         }
-#endif
-        else{
-            printf("Invalid size format\n");
+        if(shmem_exec_command && !shmem_exec(&shm, shmem_exec_command)) {
+            return 1;
+        }
+        bool held = hold_memory(NULL, NULL, timeout, false, 0, 0, ap_get_int_value(parser, "sample"));
+        if(fast) {
             exit(0);
         }
-    }else{
-        size=atoi(memory_to_eat);
-    }
-    if(size <=0 ) {
-        printf("ERROR: Size must be a positive integer");
-        exit(1);
+        shmem_digest(&shm);
+        return held ? 0 : 1;
+    } else if(strcmp(backing, "anon") != 0) {
+        printf("ERROR: Invalid backing %s", backing);
+        return 1;
     }
-    printf("Eating %ld bytes in chunks of %d...\n",size,chunk);
-    short** eaten = eat(size,chunk);
-    if(eaten){
-        if(timeout < 0 && isatty(fileno(stdin))) {
-            printf("Done, press ENTER to free the memory\n");
-            getchar();
-        } else if (timeout >= 0) {
-            printf("Done, sleeping for %d seconds before exiting...\n", timeout);
-            sleep(timeout);
-        } else {
-            printf("Done, kill this process to free the memory\n");
-            while(true) {
-                sleep(1);
-            }
+#endif
+    int method = release_method(release);
+    if(verify && method == RELEASE_FREE) {
+        // The pattern is laid out per page, so verified memory is eaten in
+        // extents rather than 1 KiB chunks.
+        if(ap_found(parser, "release")) {
+            printf("ERROR: --verify needs extents, use --release munmap|dontneed|madv-free");
+            return 1;
         }
-        digest(eaten, size, chunk);
-    }else{
+        printf("Verifying, so the memory is eaten in extents and released with munmap\n");
+        method = RELEASE_MUNMAP;
+        release = "munmap";
+    }
+    if(method < 0 || release_threads < 1) {
+        printf("ERROR: Invalid release method or thread count");
+        return 1;
+    }
+    if(precise < 0 || measure < 0) {
+        printf("ERROR: Invalid precision or measure");
+        return 1;
+    }
+    Victim* victim = start_victim(parser);
+    EatMemory* em = em_new(method == RELEASE_FREE ? chunk : 0);
+    PerfCounters counters;
+    PerfPhase phases[3];
+    int phase_count = 1;
+    bool verified = true;
+    long long start = now_ns();
+    if(method == RELEASE_FREE) {
+        printf("Eating %ld bytes in chunks of %d...\n",size,chunk);
+    } else {
+        printf("Eating %ld bytes in extents of %ld...\n",size,EXTENT_SIZE);
+    }
+    victim_phase(victim, "fill");
+    perf_begin(&counters, perf);
+    bool eaten = em != NULL && em_grow(em, size) == 0;
+    perf_end(&counters, &phases[0], "fill");
+    if(!eaten){
         printf("ERROR: Could not allocate the memory");
+        return 1;
+    }
+    printf("Eaten in %.1f ms\n", (now_ns() - start) / 1e6);
+    if(precise > 0 && !settle_memory(em, size, precise / 100, measure)) {
+        return 1;
+    }
+    if(verify) {
+        long long pattern_start = now_ns();
+        verify_fill_extents(&em->extents, seed);
+        printf("Pattern written in %.1f ms\n", (now_ns() - pattern_start) / 1e6);
     }
+#ifdef INSPECT
+    if(inspect && method == RELEASE_FREE) {
+        inspect_chunks(em->chunks, (long)em->chunk_count * chunk, chunk);
+    } else if(inspect) {
+        inspect_extents(&em->extents);
+    }
+#else
+    (void)inspect;
+#endif
+    victim_phase(victim, "hold");
+    verified = hold_memory(em, NULL, timeout, verify, fast ? 0 : verify_interval, seed, ap_get_int_value(parser, "sample"));
+    if(fast) {
+        exit(0);
+    }
+    if(verify) {
+        victim_phase(victim, "verify");
+        perf_begin(&counters, perf);
+        verified = verify_extents(&em->extents, seed) && verified;
+        perf_end(&counters, &phases[phase_count++], "verify");
+    }
+    victim_phase(victim, "release");
+    perf_begin(&counters, perf);
+    long long released = em_release(em, release, release_threads);
+    perf_end(&counters, &phases[phase_count++], "release");
+    em_free(em);
+    printf("Released in %.1f ms\n", released / 1e6);
+    victim_finish(victim);
+    if(perf) {
+        printf("\n");
+        perf_print(phases, phase_count);
+    }
+    if(!verified && verify) {
+        printf("ERROR: The memory did not verify\n");
+        return 2;
+    } else if(!verified) {
+        return 1;
+    }
+    return 0;
+}
+
+int run_procs(ArgParser* parser, long size, int procs) {
+    int chunk=1024;
+    if(procs < 1) {
+        printf("ERROR: Number of processes must be a positive integer");
+        return 1;
+    }
+    printf("Eating %ld bytes across %d processes in chunks of %d...\n",size,procs,chunk);
+    return eat_procs(size, chunk, procs, ap_get_int_values(parser, "oom-score-adj"), ap_count(parser, "oom-score-adj"),
+                     ap_get_int_value(parser, "timeout"), ap_get_str_value(parser, "timeline"));
+}
+
+int run_cow(ArgParser* parser, long size, int children) {
+    double cow_fraction = ap_get_dbl_value(parser, "cow-fraction");
+    char* cow_writers = ap_get_str_value(parser, "cow-writers");
+    int writers = strcmp(cow_writers, "parent") == 0 ? COW_PARENT :
+                  strcmp(cow_writers, "children") == 0 ? COW_CHILDREN :
+                  strcmp(cow_writers, "both") == 0 ? COW_PARENT | COW_CHILDREN : 0;
+    if(writers == 0 || cow_fraction < 0 || cow_fraction > 1 || children < 1) {
+        printf("ERROR: Invalid copy-on-write writers or fraction");
+        return 1;
+    }
+    printf("Eating %ld bytes and forking %d children...\n",size,children);
+    return eat_cow(size, children, cow_fraction, writers);
+}
+
+int run_page_cache(ArgParser* parser, long size, char* path) {
+    char* page_cache_method = ap_get_str_value(parser, "page-cache-method");
+    int reread = ap_get_int_value(parser, "reread");
+    bool use_mmap = strcmp(page_cache_method, "mmap") == 0;
+    if((!use_mmap && strcmp(page_cache_method, "read") != 0) || reread < 0 || path == NULL) {
+        printf("ERROR: Invalid page cache file, method or re-read interval");
+        return 1;
+    }
+    printf("Filling the page cache with %ld bytes of %s...\n",size,path);
+    return eat_page_cache(size, path, use_mmap, reread, ap_get_int_value(parser, "timeout"));
+}
+
+int run_probe(ArgParser* parser, long size) {
+    int timeout = ap_get_int_value(parser, "timeout");
+    double psi_limit = ap_get_dbl_value(parser, "psi-limit");
+    double backoff = ap_get_dbl_value(parser, "backoff");
+    if(backoff < 0 || backoff >= 100 || psi_limit < 0) {
+        printf("ERROR: Invalid back-off or pressure limit");
+        return 1;
+    }
+    printf("Probing for up to %ld bytes...\n",size);
+    return eat_probe(size, psi_limit, backoff, timeout >= 0 ? timeout : 2);
+}
+
+int run_reserve(ArgParser* parser, long size) {
+    double touch = ap_get_dbl_value(parser, "touch-fraction");
+    if(touch < 0 || touch > 1) {
+        printf("ERROR: Touch fraction must be between 0 and 1");
+        return 1;
+    }
+    printf("Reserving %ld bytes...\n",size);
+    char* reserved = reserve(size, ap_found(parser, "noreserve"), touch);
+    if(reserved == NULL) {
+        printf("ERROR: Could not reserve the memory");
+        return 1;
+    }
+    bool held = hold(ap_get_int_value(parser, "timeout"));
+    if(ap_found(parser, "fast-exit")) {
+        exit(0);
+    }
+    unreserve(reserved, size);
+    return held ? 0 : 1;
+}
+
+int run_sparse(ArgParser* parser, long size) {
+    long long stride = em_parse_size(ap_get_str_value(parser, "stride"));
+    if(stride < sysconf(_SC_PAGE_SIZE)) {
+        printf("ERROR: Stride must be at least a page");
+        return 1;
+    }
+    printf("Reserving %ld bytes and touching one page every %lld bytes...\n",size,stride);
+    char* reserved = sparse(size, stride, ap_found(parser, "write"));
+    if(reserved == NULL) {
+        printf("ERROR: Could not reserve the memory");
+        return 1;
+    }
+    bool held = hold(ap_get_int_value(parser, "timeout"));
+    if(ap_found(parser, "fast-exit")) {
+        exit(0);
+    }
+    unsparse(reserved, size);
+    return held ? 0 : 1;
+}
+
+int run_bench(ArgParser* parser, long size) {
+    int repeat = ap_get_int_value(parser, "repeat");
+    if(repeat < 1) {
+        printf("ERROR: Repeat must be a positive integer");
+        return 1;
+    }
+    printf("Benchmarking allocation strategies with %ld bytes, %d runs each...\n",size,repeat);
+    return eat_bench(size, repeat, ap_get_str_value(parser, "json"));
+}
+
+int run_churn(ArgParser* parser, long size) {
+    int lifetime = ap_get_int_value(parser, "lifetime");
+    if(lifetime < 1) {
+        printf("ERROR: Lifetime must be a positive integer");
+        return 1;
+    }
+    printf("Churning %ld bytes of live heap...\n",size);
+    return eat_churn(size, ap_get_str_value(parser, "sizes"), lifetime, ap_get_int_value(parser, "timeout"));
+}
+
+int run_tlb(long size) {
+    printf("Walking %ld bytes one cache line per page...\n",size);
+    return eat_tlb(size);
+}
+
+#ifdef CACHE_MODE
+int run_cache(ArgParser* parser, double fraction) {
+    char* pin = ap_get_str_value(parser, "cache-pin");
+    bool per_core = strcmp(pin, "core") == 0;
+    if(fraction <= 0 || (!per_core && strcmp(pin, "socket") != 0)) {
+        printf("ERROR: Invalid cache fraction or pinning");
+        return 1;
+    }
+    return eat_cache(fraction, per_core, ap_get_int_value(parser, "timeout"));
+}
+#endif
+
+int cmd_hold(char* name, ArgParser* parser) {
+    (void)name;
+#ifdef INSPECT
+    return run_hold(parser, size_arg(parser, COMMON_ALL), ap_found(parser, "inspect"));
+#else
+    return run_hold(parser, size_arg(parser, COMMON_ALL), false);
+#endif
+}
+
+#ifdef INSPECT
+int cmd_inspect(char* name, ArgParser* parser) {
+    (void)name;
+    return run_hold(parser, size_arg(parser, COMMON_ALL), true);
+}
+#endif
+
+int cmd_ramp(char* name, ArgParser* parser) {
+    (void)name;
+    long size = size_arg(parser, COMMON_TIMEOUT | COMMON_KERNEL | COMMON_FILL);
+    long long step = em_parse_size(ap_get_str_value(parser, "step"));
+    int interval = ap_get_int_value(parser, "interval");
+    if(step <= 0 || interval < 0) {
+        printf("ERROR: Invalid ramp step or interval");
+        return 1;
+    }
+    printf("Ramping up to %ld bytes, %lld bytes every %d seconds...\n",size,step,interval);
+    return eat_ramp(size, step, interval, ap_get_int_value(parser, "timeout"));
+}
+
+int cmd_procs(char* name, ArgParser* parser) {
+    (void)name;
+    return run_procs(parser, size_arg(parser, COMMON_TIMEOUT | COMMON_KERNEL | COMMON_FILL), ap_get_int_value(parser, "workers"));
+}
+
+int cmd_cow(char* name, ArgParser* parser) {
+    (void)name;
+    return run_cow(parser, size_arg(parser, 0), ap_get_int_value(parser, "children"));
+}
+
+int cmd_page_cache(char* name, ArgParser* parser) {
+    (void)name;
+    return run_page_cache(parser, size_arg(parser, COMMON_TIMEOUT), ap_get_str_value(parser, "file"));
+}
+
+int cmd_probe(char* name, ArgParser* parser) {
+    (void)name;
+    return run_probe(parser, size_arg(parser, COMMON_ALL));
+}
+
+int cmd_reserve(char* name, ArgParser* parser) {
+    (void)name;
+    return run_reserve(parser, size_arg(parser, COMMON_TIMEOUT | COMMON_FAST_EXIT));
+}
 
+int cmd_sparse(char* name, ArgParser* parser) {
+    (void)name;
+    return run_sparse(parser, size_arg(parser, COMMON_TIMEOUT | COMMON_FAST_EXIT));
 }
 
+int cmd_bench(char* name, ArgParser* parser) {
+    (void)name;
+    return run_bench(parser, size_arg(parser, COMMON_KERNEL | COMMON_FILL));
+}
+
+int cmd_churn(char* name, ArgParser* parser) {
+    (void)name;
+    return run_churn(parser, size_arg(parser, COMMON_TIMEOUT));
+}
+
+int cmd_tlb(char* name, ArgParser* parser) {
+    (void)name;
+    return run_tlb(size_arg(parser, 0));
+}
+
+int cmd_kernels(char* name, ArgParser* parser) {
+    (void)name;
+    long size = ap_count_args(parser) == 0 ? 64L * 1024 * 1024 : size_arg(parser, 0);
+    int repeat = ap_get_int_value(parser, "repeat");
+    if(repeat < 1) {
+        printf("ERROR: Repeat must be a positive integer");
+        return 1;
+    }
+    printf("Benchmarking the memory kernels on %ld bytes, best of %d runs...\n",size,repeat);
+    return kernel_bench(size, repeat);
+}
+
+int cmd_fill(char* name, ArgParser* parser) {
+    (void)name;
+    long size = size_arg(parser, COMMON_KERNEL);
+    long long probe_size = em_parse_size(ap_get_str_value(parser, "probe-size"));
+    int repeat = ap_get_int_value(parser, "repeat");
+    if(probe_size < 0 || repeat < 1) {
+        printf("ERROR: Invalid probe size or repeat");
+        return 1;
+    }
+    if(probe_size > 0 && probe_size < FILL_MIN_PROBE_SIZE) {
+        printf("ERROR: Probe size must be at least %d bytes", FILL_MIN_PROBE_SIZE);
+        return 1;
+    }
+    printf("Comparing fill methods on %ld bytes, best of %d runs...\n",size,repeat);
+    return eat_fill(size, probe_size, repeat);
+}
+
+#ifdef COHERENCE_MODE
+int cmd_coherence(char* name, ArgParser* parser) {
+    (void)name;
+    int threads = ap_get_int_value(parser, "threads");
+    int sharing = ap_get_int_value(parser, "sharing");
+    char* spread = ap_get_str_value(parser, "spread");
+    bool scatter = strcmp(spread, "scatter") == 0;
+    if(threads < 0 || sharing < 1 || sharing > 8 || (!scatter && strcmp(spread, "compact") != 0)) {
+        printf("ERROR: Invalid threads, sharing degree or spread");
+        return 1;
+    }
+    return eat_coherence(threads, sharing, scatter, ap_get_int_value(parser, "timeout"));
+}
+#endif
+
+int cmd_run(char* name, ArgParser* parser) {
+    (void)name;
+    if(ap_count_args(parser) != 1) {
+        puts(ap_get_helptext(parser));
+        return 1;
+    }
+    return run_scenario(ap_get_args(parser)[0], start_victim(parser));
+}
+
+#ifdef CACHE_MODE
+int cmd_cache(char* name, ArgParser* parser) {
+    (void)name;
+    if(ap_count_args(parser) != 1) {
+        puts(ap_get_helptext(parser));
+        return 1;
+    }
+    return run_cache(parser, atof(ap_get_args(parser)[0]));
+}
+#endif
+
+// Registers command [name]; the caller adds the options it accepts.
+ArgParser* add_cmd(ArgParser* parser, const char* name, ap_callback_t callback, const char* helptext) {
+    ArgParser* cmd = ap_new_cmd(parser, name);
+    ap_set_cmd_callback(cmd, callback);
+    ap_set_helptext(cmd, helptext);
+    return cmd;
+}
+
+void configure_commands(ArgParser* parser) {
+    ArgParser* cmd;
+    cmd = add_cmd(parser, "hold", cmd_hold,
+        "Usage: eatmemory hold [options] <size>\n\n"
+        "Eat size bytes and hold them until -t seconds pass or the process is\n"
+        "interrupted. This is what eatmemory <size> does, and it accepts the same\n"
+        "--release, --release-threads, --verify, --verify-interval, --seed, --perf,\n"
+        "--sample, --precise, --precise-measure, --kind, --victim, --victim-size,\n"
+        "--inspect, --backing, --hugetlb, --seal, --shmem-exec and --fast-exit\n"
+        "options, see eatmemory --help.\n\n"
+        "While holding, stdin accepts one command per line: grow <size>,\n"
+        "shrink <size>, stats, and quit or an empty line to free the memory.");
+    add_hold_opts(cmd);
+#ifdef INSPECT
+    cmd = add_cmd(parser, "inspect", cmd_inspect,
+        "Usage: eatmemory inspect [options] <size>\n\n"
+        "Eat size bytes like hold --inspect, and report what backs them: physical\n"
+        "contiguity, huge pages, zero pages, swap and KSM.");
+    add_hold_opts(cmd);
+#endif
+    cmd = add_cmd(parser, "ramp", cmd_ramp,
+        "Usage: eatmemory ramp [options] <size>\n\n"
+        "Eat size bytes gradually, reporting RSS and memory stall after each step,\n"
+        "then hold them.\n\n"
+        "-t <seconds>         Exit after holding the memory for seconds\n"
+        "--step <size>        Bytes added per step (default 64M)\n"
+        "--interval <seconds> Seconds between steps (default 1)");
+    add_common_opts(cmd, COMMON_TIMEOUT | COMMON_KERNEL | COMMON_FILL);
+    ap_add_str_opt(cmd, "step", "64M");
+    ap_add_int_opt(cmd, "interval", 1);
+    cmd = add_cmd(parser, "run", cmd_run,
+        "Usage: eatmemory run <scenario>\n\n"
+        "Run the phases of a scenario file one after the other on the same memory,\n"
+        "reporting each phase. Each line names a mode and its key=value parameters:\n\n"
+        "eat size=<size>                     Grow or shrink the memory to size\n"
+        "ramp size=<size> duration=<time>    Grow or shrink it gradually\n"
+        "touch duration=<time>               Rewrite every page in a loop\n"
+        "hold duration=<time>                Leave it alone\n"
+        "pageout                             Ask the kernel to swap it out\n"
+        "verify [seed=<n>]                   Check the pattern written when eaten\n"
+        "release [method=<m>] [threads=<n>]  Release it (default munmap)\n\n"
+        "Percent sizes are of the memory available at the start, times are in\n"
+        "seconds unless suffixed with m or h.\n\n"
+        "--victim             Measure the interference on a victim workload\n"
+        "--victim-size <size> Working set of the victim (default 1M)");
+    add_victim_opts(cmd);
+    cmd = add_cmd(parser, "probe", cmd_probe,
+        "Usage: eatmemory probe [options] <size>\n\n"
+        "Find the largest amount of memory, up to size, that can reliably be held,\n"
+        "hold it for -t seconds (default 2) and exit.\n\n"
+        "--psi-limit <percent> Memory stall share that stops a step (default 10)\n"
+        "--backoff <percent>   How far to back off from the peak (default 5)");
+    add_common_opts(cmd, COMMON_ALL);
+    add_probe_opts(cmd);
+    cmd = add_cmd(parser, "bench", cmd_bench,
+        "Usage: eatmemory bench [options] <size>\n\n"
+        "Compare how fast each allocation strategy fills size bytes.\n\n"
+        "--repeat <n>  Runs per strategy (default 5)\n"
+        "--json <file> Also write the results to file as JSON");
+    add_common_opts(cmd, COMMON_KERNEL | COMMON_FILL);
+    add_bench_opts(cmd);
+    cmd = add_cmd(parser, "churn", cmd_churn,
+        "Usage: eatmemory churn [options] <size>\n\n"
+        "Keep size as live heap while allocating and freeing objects, and report\n"
+        "allocator throughput and bloat for -t seconds.\n\n"
+        "--sizes <size:weight,...> Object size distribution\n"
+        "--lifetime <steps>        Average object lifetime (default 1000)");
+    add_common_opts(cmd, COMMON_TIMEOUT);
+    add_churn_opts(cmd);
+    cmd = add_cmd(parser, "cow", cmd_cow,
+        "Usage: eatmemory cow [options] <size>\n\n"
+        "Fill size bytes, fork children sharing them and measure fork latency and\n"
+        "copy-on-write faults.\n\n"
+        "--children <k>       Number of children (default 2)\n"
+        "--cow-fraction <f>   Fraction of pages written after the fork (default 0.5)\n"
+        "--cow-writers <parent|children|both>\n"
+        "                     Who writes to the pages (default both)");
+    ap_add_int_opt(cmd, "children", 2);
+    add_cow_opts(cmd);
+    cmd = add_cmd(parser, "page-cache", cmd_page_cache,
+        "Usage: eatmemory page-cache --file <file> [options] <size>\n\n"
+        "Fill the page cache with a size byte scratch file and keep it hot.\n\n"
+        "--file <file>        Scratch file to create, which must not exist\n"
+        "--page-cache-method <read|mmap>\n"
+        "                     Keep it hot with reads or a shared mapping (default read)\n"
+        "--reread <seconds>   Seconds between re-reads (default 5)");
+    add_common_opts(cmd, COMMON_TIMEOUT);
+    ap_add_str_opt(cmd, "file", NULL);
+    add_page_cache_opts(cmd);
+    cmd = add_cmd(parser, "procs", cmd_procs,
+        "Usage: eatmemory procs [options] <size>\n\n"
+        "Split size bytes across worker processes and report which of them get\n"
+        "OOM-killed, and when.\n\n"
+        "--workers <n>        Number of worker processes (default 2)\n"
+        "--oom-score-adj <adj>\n"
+        "                     oom_score_adj of the next worker, repeat once per worker\n"
+        "--timeline <file>    Also write the worker timeline to file as CSV");
+    add_common_opts(cmd, COMMON_TIMEOUT | COMMON_KERNEL | COMMON_FILL);
+    ap_add_int_opt(cmd, "workers", 2);
+    add_procs_opts(cmd);
+    cmd = add_cmd(parser, "reserve", cmd_reserve,
+        "Usage: eatmemory reserve [options] <size>\n\n"
+        "Map size bytes without touching them, consuming commit charge but not RAM.\n\n"
+        "--noreserve          Map the memory with MAP_NORESERVE\n"
+        "--touch-fraction <f> Fraction of the pages to touch (default 0)");
+    add_common_opts(cmd, COMMON_TIMEOUT | COMMON_FAST_EXIT);
+    add_reserve_opts(cmd);
+    cmd = add_cmd(parser, "sparse", cmd_sparse,
+        "Usage: eatmemory sparse [options] <size>\n\n"
+        "Reserve size bytes of address space and read one page every stride bytes,\n"
+        "which maps the shared zero page, so that the memory consumed is almost\n"
+        "only page tables. Report the PageTables growth and the touch rate, then\n"
+        "hold the memory for -t seconds.\n\n"
+        "--stride <size>  Distance between touched pages (default 2M)\n"
+        "--write          Write the pages instead, so each one also takes a page\n"
+        "                 of RAM, like a large sparse heap");
+    add_common_opts(cmd, COMMON_TIMEOUT | COMMON_FAST_EXIT);
+    add_sparse_opts(cmd);
+    cmd = add_cmd(parser, "kernels", cmd_kernels,
+        "Usage: eatmemory kernels [options] [size]\n\n"
+        "Measure the fill, touch, copy and checksum throughput of the memory kernels\n"
+        "of every instruction set this CPU supports on size bytes (default 64M).\n"
+        "The fastest one is used unless another is picked with --kernel.\n\n"
+        "--repeat <n>  Runs per kernel, the best one counts (default 3)");
+    ap_add_int_opt(cmd, "repeat", 3);
+    cmd = add_cmd(parser, "fill", cmd_fill,
+        "Usage: eatmemory fill [options] <size>\n\n"
+        "Fill size bytes of fresh memory with ordinary stores, non-temporal stores\n"
+        "and rep stosb, and report the throughput of each next to the latency and\n"
+        "cache misses of a probe thread on another CPU, to compare how much each\n"
+        "pollutes the last-level cache.\n\n"
+        "--probe-size <size> Probe working set (default half the last-level cache)\n"
+        "--repeat <n>        Runs per method, the fastest one counts (default 3)");
+    add_common_opts(cmd, COMMON_KERNEL);
+    ap_add_str_opt(cmd, "probe-size", "0");
+    ap_add_int_opt(cmd, "repeat", 3);
+    cmd = add_cmd(parser, "tlb", cmd_tlb,
+        "Usage: eatmemory tlb <size>\n\n"
+        "Touch one cache line per page of size bytes in random order and report\n"
+        "the cost per access with small and huge pages.");
+#ifdef COHERENCE_MODE
+    cmd = add_cmd(parser, "coherence", cmd_coherence,
+        "Usage: eatmemory coherence [options]\n\n"
+        "Make pinned threads write to their own words of shared cache lines, so the\n"
+        "lines bounce between caches, and report the writes per second for -t\n"
+        "seconds. Then report the cache line transfer latency between every pair\n"
+        "of the CPUs used.\n\n"
+        "--threads <n>                Number of threads (default one per CPU)\n"
+        "--sharing <k>                Threads sharing each cache line, 1-8 (default 2)\n"
+        "--spread <compact|scatter>   Fill one socket after the other, or alternate\n"
+        "                             between sockets (default compact)");
+    add_common_opts(cmd, COMMON_TIMEOUT);
+    ap_add_int_opt(cmd, "threads", 0);
+    ap_add_int_opt(cmd, "sharing", 2);
+    ap_add_str_opt(cmd, "spread", "compact");
+#endif
+#ifdef CACHE_MODE
+    cmd = add_cmd(parser, "cache", cmd_cache,
+        "Usage: eatmemory cache [options] <fraction>\n\n"
+        "Keep fraction of each last-level cache occupied and report the access rate\n"
+        "for -t seconds.\n\n"
+        "--cache-pin <core|socket> One worker per core or per cache (default socket)");
+    add_common_opts(cmd, COMMON_TIMEOUT);
+    ap_add_str_opt(cmd, "cache-pin", "socket");
+#endif
+}
+
+// The root parser accepts every option of every mode, with the mode selected
+// by a flag, so that eatmemory <size> keeps working as it always has.
+ArgParser* configure_cmd() {
+    ArgParser* parser = ap_new_parser();
+    ap_add_flag(parser, "help h ?");
+    add_hold_opts(parser);
+    ap_add_int_opt(parser, "procs", 1);
+    add_procs_opts(parser);
+    ap_add_int_opt(parser, "cow", 0);
+    add_cow_opts(parser);
+    ap_add_str_opt(parser, "page-cache", NULL);
+    add_page_cache_opts(parser);
+    ap_add_flag(parser, "tlb");
+    ap_add_flag(parser, "probe");
+    add_probe_opts(parser);
+    ap_add_flag(parser, "reserve-only");
+    add_reserve_opts(parser);
+    ap_add_flag(parser, "sparse");
+    add_sparse_opts(parser);
+    ap_add_flag(parser, "bench");
+    add_bench_opts(parser);
+    ap_add_flag(parser, "churn");
+    add_churn_opts(parser);
+#ifdef CACHE_MODE
+    ap_add_dbl_opt(parser, "cache", 0);
+    ap_add_str_opt(parser, "cache-pin", "socket");
+#endif
+    configure_commands(parser);
+    return parser;
+}
+
+int main(int argc, char *argv[]){
+
+    if(em_total_system_memory() >= 0) {
+        printf("Currently total memory: %lld\n",em_total_system_memory());
+        printf("Currently avail memory: %lld\n",em_free_system_memory());
+    }
+
+    ArgParser* parser = configure_cmd();
+    ap_parse(parser, argc, argv);
+    if(ap_found_cmd(parser)) {
+        exit(ap_get_cmd_exit_code(parser));
+    }
+    if(ap_found(parser, "help")) {
+        print_help();
+        exit(0);
+    }
+#ifdef CACHE_MODE
+    if(ap_found(parser, "cache")) {
+        exit(run_cache(parser, ap_get_dbl_value(parser, "cache")));
+    }
+#endif
+    long size = size_arg(parser, COMMON_ALL);
+    if(ap_found(parser, "tlb")) {
+        exit(run_tlb(size));
+    }
+    if(ap_found(parser, "probe")) {
+        exit(run_probe(parser, size));
+    }
+    if(ap_found(parser, "reserve-only")) {
+        exit(run_reserve(parser, size));
+    }
+    if(ap_found(parser, "sparse")) {
+        exit(run_sparse(parser, size));
+    }
+    if(ap_found(parser, "bench")) {
+        exit(run_bench(parser, size));
+    }
+    if(ap_found(parser, "churn")) {
+        exit(run_churn(parser, size));
+    }
+    if(ap_found(parser, "page-cache")) {
+        exit(run_page_cache(parser, size, ap_get_str_value(parser, "page-cache")));
+    }
+    if(ap_get_int_value(parser, "cow") > 0) {
+        exit(run_cow(parser, size, ap_get_int_value(parser, "cow")));
+    }
+    if(ap_get_int_value(parser, "procs") != 1) {
+        exit(run_procs(parser, size, ap_get_int_value(parser, "procs")));
+    }
+#ifdef INSPECT
+    exit(run_hold(parser, size, ap_found(parser, "inspect")));
+#else
+    exit(run_hold(parser, size, false));
+#endif
+}
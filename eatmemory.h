@@ -0,0 +1,105 @@
+// -----------------------------------------------------------------------------
+// libeatmemory: create memory pressure from within a process.
+// -----------------------------------------------------------------------------
+
+#ifndef eatmemory_h
+#define eatmemory_h
+
+#define EATMEMORY_VERSION "0.1.10"
+
+// Marks the functions exported by libeatmemory.so, which is built with every
+// other symbol hidden.
+#if defined(__GNUC__)
+#define EM_API __attribute__((visibility("default")))
+#else
+#define EM_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+// Types.
+// -----------------------------------------------------------------------------
+
+// An EatMemory instance owns the memory it has eaten.
+typedef struct EatMemory EatMemory;
+
+// A snapshot of an EatMemory instance, filled in by em_stats().
+typedef struct {
+    // Bytes currently eaten.
+    long long size;
+    // Number of blocks the memory is split into (chunks or extents).
+    long long blocks;
+    // Resident set size of the whole process in bytes, or -1 if unknown.
+    long long resident;
+    // Total nanoseconds spent in em_grow(), em_shrink() and em_touch().
+    long long grow_ns;
+    long long shrink_ns;
+    long long touch_ns;
+} EatMemoryStats;
+
+// -----------------------------------------------------------------------------
+// Initialization and teardown.
+// -----------------------------------------------------------------------------
+
+// Allocates a new, empty instance. If [chunk] is positive the memory is eaten
+// with malloc() in [chunk]-sized blocks, like the eatmemory command does by
+// default; if it is zero the memory is mapped in large extents, which can be
+// released faster. Returns NULL if memory allocation fails.
+EM_API EatMemory* em_new(int chunk);
+
+// Releases the memory with free() or munmap() and frees the instance.
+EM_API void em_free(EatMemory* em);
+
+// -----------------------------------------------------------------------------
+// Growing, shrinking and touching.
+// -----------------------------------------------------------------------------
+
+// Eats [bytes] more bytes, touching every byte. Returns 0 on success and -1
+// if an allocation failed, in which case whatever was eaten before the
+// failure is kept. Like em_shrink(), rounds [bytes] up to whole chunks, or
+// whole pages for extents.
+EM_API int em_grow(EatMemory* em, long long bytes);
+
+// Releases the last [bytes] bytes eaten, rounded up to whole chunks or whole
+// pages of extents like em_grow(). Returns 0 on success.
+EM_API int em_shrink(EatMemory* em, long long bytes);
+
+// Writes to every page of the eaten memory again, without changing its
+// contents, e.g. to keep it hot or fault it back in after it was swapped out.
+EM_API void em_touch(EatMemory* em);
+
+// Fills [stats] with a snapshot of the instance.
+EM_API void em_stats(EatMemory* em, EatMemoryStats* stats);
+
+// Releases all the eaten memory with [method] ("free", "munmap", "dontneed"
+// or "madv-free"; only "free" applies to chunks) from [threads] threads. The
+// instance stays usable and empty. Returns the elapsed nanoseconds, or -1 if
+// the method is not supported.
+EM_API long long em_release(EatMemory* em, const char* method, int threads);
+
+// -----------------------------------------------------------------------------
+// Sizing.
+// -----------------------------------------------------------------------------
+
+// Parses a size as accepted by the eatmemory command: bytes ("1024"),
+// megabytes ("15M"), gigabytes ("2G") or a percentage of the free memory
+// ("50%"). Returns -1 if the size is not valid or does not fit in a long long.
+EM_API long long em_parse_size(const char* text);
+
+// Returns the total physical memory in bytes, or -1 if unknown.
+EM_API long long em_total_system_memory(void);
+
+// Returns the free physical memory in bytes, or -1 if unknown.
+EM_API long long em_free_system_memory(void);
+
+// Returns EATMEMORY_VERSION of the library in use.
+EM_API const char* em_version(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,271 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "cache.h"
+#include "fill.h"
+#include "kernel.h"
+#include "perf.h"
+#include "util.h"
+
+#ifdef PERF_COUNTERS
+#include <linux/perf_event.h>
+#endif
+
+#define LINE 64
+#define CHASE_BATCH 4096
+#define DEFAULT_PROBE_SIZE (4L * 1024 * 1024)
+#define BASELINE_NS 200000000LL
+
+typedef struct {
+    int cpu;
+    long size;
+    volatile bool stop;
+    // Set by the probe if it could not set its working set up.
+    volatile bool failed;
+    // Written by the probe after every batch and read by the filling thread
+    // through sample(), under the sequence count [seq], which is odd while a
+    // write is in progress.
+    unsigned seq;
+    long long accesses;
+    long long ns;
+    long long misses;
+} Probe;
+
+// A snapshot of the probe's counters.
+typedef struct {
+    long long accesses;
+    long long ns;
+    long long misses;
+} ProbeSample;
+
+static const char* METHODS[] = { "store", "stream", "stosb" };
+
+// Links the cache lines of [size] bytes at [base] into one random cycle.
+// Returns false if memory allocation fails.
+static bool link_lines(char* base, long size) {
+    long lines = size / LINE;
+    long* order = malloc(sizeof(long) * lines);
+    if(order == NULL) {
+        return false;
+    }
+    unsigned long long state = 88172645463325252ULL;
+    for(long i = 0; i < lines; i++) {
+        order[i] = i;
+    }
+    for(long i = lines - 1; i > 0; i--) {
+        long j = xorshift(&state) % (i + 1);
+        long t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    for(long i = 0; i < lines; i++) {
+        *(char**)(base + order[i] * LINE) = base + order[(i + 1) % lines] * LINE;
+    }
+    free(order);
+    return true;
+}
+
+static void* chase(void* arg) {
+    Probe* probe = arg;
+#ifdef __linux__
+    if(probe->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(probe->cpu, &set);
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+#endif
+    char* base = malloc(probe->size);
+    if(base == NULL || !link_lines(base, probe->size)) {
+        free(base);
+        probe->failed = true;
+        return NULL;
+    }
+#ifdef PERF_COUNTERS
+    int fd = perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+#endif
+    char** volatile sink = (char**)base;
+    long long start = now_ns();
+    long long accesses = 0;
+    unsigned seq = 0;
+    while(!probe->stop) {
+        char** p = sink;
+        for(int i = 0; i < CHASE_BATCH; i++) {
+            p = (char**)*p;
+        }
+        sink = p;
+        accesses += CHASE_BATCH;
+        long long ns = now_ns() - start;
+#ifdef PERF_COUNTERS
+        long long misses = fd >= 0 ? perf_read(fd) : -1;
+#else
+        long long misses = -1;
+#endif
+        __atomic_store_n(&probe->seq, ++seq, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        __atomic_store_n(&probe->accesses, accesses, __ATOMIC_RELAXED);
+        __atomic_store_n(&probe->ns, ns, __ATOMIC_RELAXED);
+        __atomic_store_n(&probe->misses, misses, __ATOMIC_RELAXED);
+        __atomic_store_n(&probe->seq, ++seq, __ATOMIC_RELEASE);
+    }
+#ifdef PERF_COUNTERS
+    perf_close(fd);
+#endif
+    free(base);
+    return NULL;
+}
+
+// Reads the probe's counters from the same batch, retrying while the probe is
+// writing them.
+static ProbeSample sample(Probe* probe) {
+    ProbeSample s;
+    unsigned seq;
+    do {
+        seq = __atomic_load_n(&probe->seq, __ATOMIC_ACQUIRE);
+        s.accesses = __atomic_load_n(&probe->accesses, __ATOMIC_RELAXED);
+        s.ns = __atomic_load_n(&probe->ns, __ATOMIC_RELAXED);
+        s.misses = __atomic_load_n(&probe->misses, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while((seq & 1) || __atomic_load_n(&probe->seq, __ATOMIC_RELAXED) != seq);
+    return s;
+}
+
+// Prints the probe's latency and misses per access between [from] and [to],
+// and its slowdown relative to [baseline_ns] per access.
+static void print_probe(ProbeSample from, ProbeSample to, double baseline_ns) {
+    long long accesses = to.accesses - from.accesses;
+    double ns = accesses > 0 ? (double)(to.ns - from.ns) / accesses : 0;
+    printf("  %10.2f  %10.1f%%", ns, baseline_ns > 0 ? 100 * (ns - baseline_ns) / baseline_ns : 0);
+    if(from.misses >= 0 && to.misses >= 0 && accesses > 0) {
+        printf("  %14.3f\n", (double)(to.misses - from.misses) / accesses);
+    } else {
+        printf("  %14s\n", "n/a");
+    }
+}
+
+// Picks two CPUs this process may run on, for the filling thread and the
+// probe. Sets both to -1 if there is only one.
+static void pick_cpus(int* filler, int* prober) {
+    *filler = -1;
+    *prober = -1;
+#ifdef __linux__
+    cpu_set_t set;
+    if(sched_getaffinity(0, sizeof(set), &set) != 0) {
+        return;
+    }
+    for(int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if(CPU_ISSET(cpu, &set)) {
+            if(*filler < 0) {
+                *filler = cpu;
+            } else {
+                *prober = cpu;
+                break;
+            }
+        }
+    }
+    if(*prober < 0) {
+        *filler = -1;
+    } else {
+        CPU_ZERO(&set);
+        CPU_SET(*filler, &set);
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+#endif
+}
+
+int eat_fill(long total, long probe_size, int repeat) {
+    Probe probe;
+    int filler;
+    pick_cpus(&filler, &probe.cpu);
+#ifdef CACHE_MODE
+    if(probe_size == 0) {
+        long llc = last_level_cache_size(filler >= 0 ? filler : 0);
+        probe_size = llc > 0 ? llc / 2 : DEFAULT_PROBE_SIZE;
+    }
+#endif
+    if(probe_size == 0) {
+        probe_size = DEFAULT_PROBE_SIZE;
+    }
+    probe.size = probe_size / LINE * LINE;
+    probe.stop = false;
+    probe.failed = false;
+    probe.seq = 0;
+    probe.accesses = 0;
+    probe.ns = 0;
+    probe.misses = -1;
+    if(probe.cpu >= 0) {
+        printf("Probe: %ld KiB working set on CPU %d, filling on CPU %d\n", probe.size / 1024, probe.cpu, filler);
+    } else {
+        printf("Probe: %ld KiB working set, time sharing the only CPU with the fill\n", probe.size / 1024);
+    }
+
+    pthread_t thread;
+    if(pthread_create(&thread, NULL, chase, &probe) != 0) {
+        printf("ERROR: Could not start the probe thread\n");
+        return 1;
+    }
+    // Let the probe warm its working set up before measuring the baseline.
+    while(!probe.failed && sample(&probe).accesses < probe.size / LINE * 4) {
+        sched_yield();
+    }
+    if(probe.failed) {
+        pthread_join(thread, NULL);
+        printf("ERROR: Could not allocate the probe's working set\n");
+        return 1;
+    }
+    volatile sig_atomic_t never = 0;
+    ProbeSample before = sample(&probe);
+    sleep_ns(BASELINE_NS, &never);
+    ProbeSample after = sample(&probe);
+    double baseline_ns = (double)(after.ns - before.ns) / (after.accesses - before.accesses);
+
+    printf("%-8s  %10s  %10s  %11s  %14s\n", "METHOD", "FILL_GBS", "PROBE_NS", "SLOWDOWN", "LLC_MISS/ACC");
+    printf("%-8s  %10s", "idle", "");
+    print_probe(before, after, baseline_ns);
+    int status = 0;
+    for(int m = 0; m < (int)(sizeof(METHODS) / sizeof(METHODS[0])); m++) {
+        int method = kernel_fill_method(METHODS[m]);
+        if(method < 0) {
+            printf("%-8s  %10s\n", METHODS[m], "unsupported");
+            continue;
+        }
+        kernel_use_fill(method);
+        long long best = -1;
+        ProbeSample from = sample(&probe), to = from;
+        for(int r = 0; r < repeat; r++) {
+            char* base = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(base == MAP_FAILED) {
+                printf("ERROR: Could not allocate the memory\n");
+                status = 1;
+                break;
+            }
+            ProbeSample s = sample(&probe);
+            long long start = now_ns();
+            kernel_fill(base, total, 0);
+            long long elapsed = now_ns() - start;
+            if(best < 0 || elapsed < best) {
+                best = elapsed;
+                from = s;
+                to = sample(&probe);
+            }
+            munmap(base, total);
+        }
+        if(best > 0) {
+            printf("%-8s  %10.2f", METHODS[m], (double)total / best);
+            print_probe(from, to, baseline_ns);
+        }
+    }
+    kernel_use_fill(FILL_STORE);
+    probe.stop = true;
+    pthread_join(thread, NULL);
+    return status;
+}
@@ -0,0 +1,17 @@
+#ifndef fill_h
+#define fill_h
+
+// Smallest probe working set, two cache lines to chase between.
+#define FILL_MIN_PROBE_SIZE 128
+
+// Fills [total] bytes of freshly mapped memory with each fill method (store,
+// stream and, on x86, stosb), best of [repeat] runs, while a probe thread on
+// another CPU chases pointers through [probe_size] bytes. Reports the fill
+// throughput next to the probe's latency and last-level cache misses per
+// access, so the cache pollution of each method can be compared with an idle
+// baseline. [probe_size] of 0 uses half the last-level cache, otherwise it
+// must be at least FILL_MIN_PROBE_SIZE. Returns the
+// process exit code.
+int eat_fill(long total, long probe_size, int repeat);
+
+#endif
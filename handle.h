@@ -0,0 +1,23 @@
+#ifndef handle_h
+#define handle_h
+
+#include "eat.h"
+#include "eatmemory.h"
+
+// Layout of an EatMemory instance. Shared by the library and the eatmemory
+// command, which looks inside it to inspect and verify the memory; it is not
+// part of the public API.
+struct EatMemory {
+    int chunk;
+    // Chunk mode.
+    short** chunks;
+    long chunk_count;
+    long chunk_capacity;
+    // Extent mode.
+    Extents extents;
+    long long grow_ns;
+    long long shrink_ns;
+    long long touch_ns;
+};
+
+#endif
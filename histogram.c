@@ -0,0 +1,50 @@
+#include <string.h>
+#include "histogram.h"
+
+static int bucket_of(long long ns) {
+    if(ns < 128) {
+        return ns < 0 ? 0 : (int)ns;
+    }
+    int e = 63 - __builtin_clzll((unsigned long long)ns);
+    int index = 128 + (e - 7) * 64 + (int)((ns >> (e - 6)) & 63);
+    return index < HISTOGRAM_BUCKETS ? index : HISTOGRAM_BUCKETS - 1;
+}
+
+static long long bucket_value(int index) {
+    if(index < 128) {
+        return index;
+    }
+    int e = (index - 128) / 64 + 7;
+    long long sub = (index - 128) % 64;
+    return (1LL << e) + (sub << (e - 6));
+}
+
+void hist_clear(Histogram* hist) {
+    memset(hist, 0, sizeof(*hist));
+}
+
+void hist_record(Histogram* hist, long long ns) {
+    hist->counts[bucket_of(ns)]++;
+    hist->total++;
+    if(ns > hist->max) {
+        hist->max = ns;
+    }
+}
+
+long long hist_percentile(const Histogram* hist, double p) {
+    if(hist->total == 0) {
+        return 0;
+    }
+    long long rank = (long long)(hist->total * p / 100.0);
+    if(rank >= hist->total) {
+        return hist->max;
+    }
+    long long seen = 0;
+    for(int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += hist->counts[i];
+        if(seen > rank) {
+            return bucket_value(i);
+        }
+    }
+    return hist->max;
+}
@@ -0,0 +1,23 @@
+#ifndef histogram_h
+#define histogram_h
+
+// Log-linear histogram of nanosecond latencies: exact below 128 ns, and with
+// 64 sub-buckets per power of two above that (under 2% error).
+#define HISTOGRAM_BUCKETS (128 + 40 * 64)
+
+typedef struct {
+    long long counts[HISTOGRAM_BUCKETS];
+    long long total;
+    long long max;
+} Histogram;
+
+// Resets the histogram to empty.
+void hist_clear(Histogram* hist);
+
+// Records a single value.
+void hist_record(Histogram* hist, long long ns);
+
+// Returns the value at percentile [p] (0-100), or 0 if the histogram is empty.
+long long hist_percentile(const Histogram* hist, double p);
+
+#endif
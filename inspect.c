@@ -0,0 +1,173 @@
+#define _GNU_SOURCE
+
+#include "inspect.h"
+
+#ifdef INSPECT
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define BATCH 65536
+
+#define PM_PRESENT (1ULL << 63)
+#define PM_SWAPPED (1ULL << 62)
+#define PM_PFN_MASK ((1ULL << 55) - 1)
+
+#define KPF_KSM 21
+#define KPF_THP 22
+#define KPF_ZERO_PAGE 24
+
+static void end_run(InspectStats* stats) {
+    if(stats->run == 0) {
+        return;
+    }
+    int bucket = 63 - __builtin_clzll(stats->run);
+    if(bucket >= INSPECT_RUN_BUCKETS) {
+        bucket = INSPECT_RUN_BUCKETS - 1;
+    }
+    stats->runs[bucket]++;
+    stats->run_pages[bucket] += stats->run;
+    stats->run = 0;
+}
+
+void inspect_init(InspectStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+// Looks up the flags of [count] physically contiguous pages starting at
+// [pfn] with a single read.
+static void add_flags(InspectStats* stats, int kpageflags, unsigned long long pfn, long count) {
+    uint64_t flags[256];
+    while(count > 0) {
+        long n = count < 256 ? count : 256;
+        ssize_t got = pread(kpageflags, flags, n * sizeof(uint64_t), pfn * sizeof(uint64_t));
+        if(got <= 0) {
+            return;
+        }
+        n = got / sizeof(uint64_t);
+        for(long i = 0; i < n; i++) {
+            stats->flags_known++;
+            stats->thp += (flags[i] >> KPF_THP) & 1;
+            stats->zero += (flags[i] >> KPF_ZERO_PAGE) & 1;
+            stats->ksm += (flags[i] >> KPF_KSM) & 1;
+        }
+        pfn += n;
+        count -= n;
+    }
+}
+
+bool inspect_range(InspectStats* stats, const char* base, long size) {
+    long page = sysconf(_SC_PAGE_SIZE);
+    int pagemap = open("/proc/self/pagemap", O_RDONLY);
+    if(pagemap < 0) {
+        perror("/proc/self/pagemap");
+        return false;
+    }
+    int kpageflags = open("/proc/kpageflags", O_RDONLY);
+    static uint64_t entries[BATCH];
+
+    uintptr_t first = (uintptr_t)base / page;
+    long pages = (long)(((uintptr_t)base + size + page - 1) / page - first);
+    for(long done = 0; done < pages; ) {
+        long n = pages - done < BATCH ? pages - done : BATCH;
+        ssize_t got = pread(pagemap, entries, n * sizeof(uint64_t), (first + done) * sizeof(uint64_t));
+        if(got <= 0) {
+            break;
+        }
+        n = got / sizeof(uint64_t);
+        // Start of the contiguous run within this batch whose flags have not
+        // been looked up yet.
+        unsigned long long flags_pfn = 0;
+        long flags_count = 0;
+        for(long i = 0; i < n; i++) {
+            uint64_t e = entries[i];
+            unsigned long long pfn = e & PM_PFN_MASK;
+            stats->pages++;
+            if(!(e & PM_PRESENT)) {
+                stats->swapped += (e & PM_SWAPPED) != 0;
+                end_run(stats);
+                continue;
+            }
+            stats->present++;
+            if(pfn == 0) {
+                // Without CAP_SYS_ADMIN the kernel hides page frame numbers.
+                end_run(stats);
+                continue;
+            }
+            stats->pfn_known++;
+            if(stats->run > 0 && pfn == stats->last_pfn + 1) {
+                stats->run++;
+            } else {
+                end_run(stats);
+                stats->run = 1;
+            }
+            stats->last_pfn = pfn;
+
+            if(kpageflags >= 0) {
+                if(flags_count > 0 && pfn == flags_pfn + flags_count) {
+                    flags_count++;
+                } else {
+                    if(flags_count > 0) {
+                        add_flags(stats, kpageflags, flags_pfn, flags_count);
+                    }
+                    flags_pfn = pfn;
+                    flags_count = 1;
+                }
+            }
+        }
+        if(flags_count > 0) {
+            add_flags(stats, kpageflags, flags_pfn, flags_count);
+        }
+        done += n;
+    }
+    if(kpageflags >= 0) {
+        close(kpageflags);
+    }
+    close(pagemap);
+    return true;
+}
+
+static void print_share(const char* name, long long count, long long of) {
+    printf("%-22s %12lld pages  %6.1f%%\n", name, count, of > 0 ? 100.0 * count / of : 0);
+}
+
+void inspect_print(InspectStats* stats) {
+    end_run(stats);
+    print_share("Present", stats->present, stats->pages);
+    print_share("Swapped", stats->swapped, stats->pages);
+    print_share("Not present", stats->pages - stats->present - stats->swapped, stats->pages);
+    if(stats->flags_known > 0) {
+        print_share("THP backed", stats->thp, stats->flags_known);
+        print_share("Zero page", stats->zero, stats->flags_known);
+        print_share("KSM merged", stats->ksm, stats->flags_known);
+    } else {
+        printf("Page flags unavailable, /proc/kpageflags needs CAP_SYS_ADMIN\n");
+    }
+    if(stats->pfn_known == 0) {
+        printf("Physical addresses unavailable, /proc/self/pagemap needs CAP_SYS_ADMIN\n");
+        return;
+    }
+    printf("\nPhysically contiguous runs:\n");
+    printf("%12s  %12s  %12s  %8s\n", "PAGES", "RUNS", "TOTAL_PAGES", "SHARE");
+    for(int i = 0; i < INSPECT_RUN_BUCKETS; i++) {
+        if(stats->runs[i] == 0) {
+            continue;
+        }
+        char range[32];
+        if(i == INSPECT_RUN_BUCKETS - 1) {
+            snprintf(range, sizeof(range), "%lld+", 1LL << i);
+        } else if(i == 0) {
+            snprintf(range, sizeof(range), "1");
+        } else {
+            snprintf(range, sizeof(range), "%lld-%lld", 1LL << i, (2LL << i) - 1);
+        }
+        printf("%12s  %12lld  %12lld  %7.1f%%\n", range, stats->runs[i], stats->run_pages[i],
+            100.0 * stats->run_pages[i] / stats->pfn_known);
+    }
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef inspect_h
+#define inspect_h
+
+#include <stdbool.h>
+
+#ifdef __linux__
+#define INSPECT
+#endif
+
+#ifdef INSPECT
+
+// Number of buckets of the physical contiguity histogram: runs of 1, 2-3,
+// 4-7, ... and 2^(INSPECT_RUN_BUCKETS-1) or more pages.
+#define INSPECT_RUN_BUCKETS 12
+
+// What backs a range of virtual memory, according to /proc/self/pagemap and,
+// when readable (CAP_SYS_ADMIN), /proc/kpageflags.
+typedef struct {
+    long long pages;
+    long long present;
+    long long swapped;
+    long long pfn_known;
+    long long flags_known;
+    long long thp;
+    long long zero;
+    long long ksm;
+    long long runs[INSPECT_RUN_BUCKETS];
+    long long run_pages[INSPECT_RUN_BUCKETS];
+    // Physically contiguous run in progress.
+    unsigned long long last_pfn;
+    long long run;
+} InspectStats;
+
+// Resets the statistics.
+void inspect_init(InspectStats* stats);
+
+// Adds the pages of [size] bytes at [base] to the statistics, reading
+// pagemap in fixed size batches so any size can be inspected with a small
+// buffer. Returns false if pagemap could not be read.
+bool inspect_range(InspectStats* stats, const char* base, long size);
+
+// Prints the statistics and the contiguity histogram.
+void inspect_print(InspectStats* stats);
+
+#endif
+
+#endif
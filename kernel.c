@@ -0,0 +1,210 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "kernel.h"
+#include "util.h"
+
+#define LINE 64
+
+static const Kernel* KERNELS[] = {
+    &kernel_scalar,
+#ifdef KERNEL_X86
+    &kernel_sse2,
+    &kernel_avx2,
+    &kernel_avx512,
+#endif
+#ifdef KERNEL_NEON
+    &kernel_neon,
+#endif
+};
+
+#define KERNEL_COUNT ((int)(sizeof(KERNELS) / sizeof(KERNELS[0])))
+
+static const Kernel* current = NULL;
+static int fill_method = FILL_STORE;
+
+void kernel_fill_tail(char* dst, long size, uint8_t value) {
+    for(long i = 0; i < size; i++) {
+        dst[i] = value;
+    }
+}
+
+void kernel_touch_tail(char* base, long size) {
+    volatile char* p = base;
+    for(long i = 0; i < size; i += LINE) {
+        p[i] = p[i];
+    }
+}
+
+void kernel_copy_tail(char* dst, const char* src, long size) {
+    for(long i = 0; i < size; i++) {
+        dst[i] = src[i];
+    }
+}
+
+uint64_t kernel_checksum_tail(const char* src, long size) {
+    uint64_t sum = 0;
+    for(long i = 0; i < size; i += 8) {
+        uint64_t word = 0;
+        memcpy(&word, src + i, size - i < 8 ? size - i : 8);
+        sum += word;
+    }
+    return sum;
+}
+
+static bool scalar_supported() {
+    return true;
+}
+
+static void scalar_fill(char* dst, long size, uint8_t value) {
+    uint64_t word = value * 0x0101010101010101ULL;
+    long words = size / 8;
+    for(long i = 0; i < words; i++) {
+        memcpy(dst + i * 8, &word, 8);
+    }
+    kernel_fill_tail(dst + words * 8, size - words * 8, value);
+}
+
+static void scalar_touch(char* base, long size) {
+    kernel_touch_tail(base, size);
+}
+
+static void scalar_copy(char* dst, const char* src, long size) {
+    long words = size / 8;
+    for(long i = 0; i < words; i++) {
+        uint64_t word;
+        memcpy(&word, src + i * 8, 8);
+        memcpy(dst + i * 8, &word, 8);
+    }
+    kernel_copy_tail(dst + words * 8, src + words * 8, size - words * 8);
+}
+
+static uint64_t scalar_checksum(const char* src, long size) {
+    return kernel_checksum_tail(src, size);
+}
+
+// Portable C has no non-temporal stores, so the scalar kernel streams with
+// ordinary ones.
+const Kernel kernel_scalar = { "scalar", scalar_supported, scalar_fill, scalar_fill, scalar_touch, scalar_copy, scalar_checksum };
+
+const Kernel* kernel_find(const char* name) {
+    const Kernel* found = NULL;
+    for(int i = 0; i < KERNEL_COUNT; i++) {
+        if(!KERNELS[i]->supported()) {
+            continue;
+        }
+        // The list is ordered from slowest to fastest.
+        if(strcmp(name, "auto") == 0 || strcmp(name, KERNELS[i]->name) == 0) {
+            found = KERNELS[i];
+        }
+    }
+    return found;
+}
+
+void kernel_use(const Kernel* kernel) {
+    current = kernel;
+}
+
+const Kernel* kernel_current() {
+    if(current == NULL) {
+        current = kernel_find("auto");
+    }
+    return current;
+}
+
+int kernel_fill_method(const char* name) {
+    if(strcmp(name, "store") == 0) {
+        return FILL_STORE;
+    } else if(strcmp(name, "stream") == 0) {
+        return FILL_STREAM;
+    }
+#ifdef KERNEL_X86
+    else if(strcmp(name, "stosb") == 0) {
+        return FILL_STOSB;
+    }
+#endif
+    return -1;
+}
+
+void kernel_use_fill(int method) {
+    fill_method = method;
+}
+
+void kernel_fill(char* dst, long size, uint8_t value) {
+    if(fill_method == FILL_STREAM) {
+        kernel_current()->stream(dst, size, value);
+    }
+#ifdef KERNEL_X86
+    else if(fill_method == FILL_STOSB) {
+        kernel_stosb(dst, size, value);
+    }
+#endif
+    else {
+        kernel_current()->fill(dst, size, value);
+    }
+}
+
+// Runs [op] of [kernel] [repeat] times and returns the best throughput in
+// GB/s.
+static double best_gbs(const Kernel* kernel, int op, char* dst, char* src, long size, int repeat, uint64_t* sum) {
+    long long best = -1;
+    for(int r = 0; r < repeat; r++) {
+        long long start = now_ns();
+        switch(op) {
+        case 0: kernel->fill(dst, size, (uint8_t)r); break;
+        case 1: kernel->touch(dst, size); break;
+        case 2: kernel->copy(dst, src, size); break;
+        case 3: *sum = kernel->checksum(dst, size); break;
+        case 4: kernel->stream(dst, size, (uint8_t)r); break;
+        }
+        long long elapsed = now_ns() - start;
+        best = best < 0 || elapsed < best ? elapsed : best;
+    }
+    return best > 0 ? (double)size / best : 0;
+}
+
+int kernel_bench(long size, int repeat) {
+    char* src = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    char* dst = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(src == MAP_FAILED || dst == MAP_FAILED) {
+        printf("ERROR: Could not allocate the memory");
+        return 1;
+    }
+    unsigned long long state = 88172645463325252ULL;
+    for(long i = 0; i + 8 <= size; i += 8) {
+        uint64_t word = xorshift(&state);
+        memcpy(src + i, &word, 8);
+    }
+    memset(dst, 0, size);
+    uint64_t expected = kernel_scalar.checksum(src, size);
+
+    int status = 0;
+    const Kernel* best = kernel_find("auto");
+    printf("%-8s  %10s  %10s  %10s  %10s  %12s\n", "KERNEL", "FILL_GBS", "STREAM_GBS", "TOUCH_GBS", "COPY_GBS", "CHECKSUM_GBS");
+    for(int i = 0; i < KERNEL_COUNT; i++) {
+        const Kernel* k = KERNELS[i];
+        if(!k->supported()) {
+            printf("%-8s  %10s\n", k->name, "unsupported");
+            continue;
+        }
+        uint64_t sum = 0;
+        double fill = best_gbs(k, 0, dst, src, size, repeat, &sum);
+        double stream = best_gbs(k, 4, dst, src, size, repeat, &sum);
+        double touch = best_gbs(k, 1, dst, src, size, repeat, &sum);
+        double copy = best_gbs(k, 2, dst, src, size, repeat, &sum);
+        double checksum = best_gbs(k, 3, dst, src, size, repeat, &sum);
+        printf("%-8s  %10.2f  %10.2f  %10.2f  %10.2f  %12.2f%s\n", k->name, fill, stream, touch, copy, checksum,
+               k == best ? "  (auto)" : "");
+        if(sum != expected) {
+            printf("ERROR: %s checksum %016llx, expected %016llx\n", k->name,
+                   (unsigned long long)sum, (unsigned long long)expected);
+            status = 2;
+        }
+    }
+    munmap(src, size);
+    munmap(dst, size);
+    return status;
+}
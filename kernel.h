@@ -0,0 +1,89 @@
+#ifndef kernel_h
+#define kernel_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNEL_X86
+#endif
+
+#if defined(__ARM_NEON)
+#define KERNEL_NEON
+#endif
+
+// Memory kernels for one instruction set. Every kernel accepts any size and
+// alignment; checksum() returns the same value on every instruction set.
+typedef struct {
+    const char* name;
+    // Returns true if the CPU and the OS support the instruction set.
+    bool (*supported)();
+    // Sets [size] bytes at [dst] to [value], like memset().
+    void (*fill)(char* dst, long size, uint8_t value);
+    // Like fill(), with non-temporal stores that bypass the caches where the
+    // instruction set has them.
+    void (*stream)(char* dst, long size, uint8_t value);
+    // Reads every cache line of [size] bytes at [base] and writes it back.
+    void (*touch)(char* base, long size);
+    // Copies [size] bytes from [src] to [dst], like memcpy().
+    void (*copy)(char* dst, const char* src, long size);
+    // Returns the sum of the 64-bit words at [src], with the last word zero
+    // padded.
+    uint64_t (*checksum)(const char* src, long size);
+} Kernel;
+
+extern const Kernel kernel_scalar;
+#ifdef KERNEL_X86
+extern const Kernel kernel_sse2;
+extern const Kernel kernel_avx2;
+extern const Kernel kernel_avx512;
+#endif
+#ifdef KERNEL_NEON
+extern const Kernel kernel_neon;
+#endif
+
+// How kernel_fill() writes the memory: with the kernel's fill() or stream(),
+// or with rep stosb, which the CPU may turn into non-temporal writes for
+// large sizes (x86 only).
+#define FILL_STORE 0
+#define FILL_STREAM 1
+#define FILL_STOSB 2
+
+#ifdef KERNEL_X86
+void kernel_stosb(char* dst, long size, uint8_t value);
+#endif
+
+// Returns the kernel called [name], or the fastest one supported if [name] is
+// "auto". Returns NULL if there is no such kernel or it is not supported.
+const Kernel* kernel_find(const char* name);
+
+// Makes [kernel] the one returned by kernel_current().
+void kernel_use(const Kernel* kernel);
+
+// Returns the kernel selected with kernel_use(), or the fastest one supported.
+const Kernel* kernel_current();
+
+// Returns the fill method called [name] ("store", "stream" or "stosb"), or -1
+// if there is no such method or it is not supported on this platform.
+int kernel_fill_method(const char* name);
+
+// Makes [method] the one used by kernel_fill(). The default is FILL_STORE.
+void kernel_use_fill(int method);
+
+// Sets [size] bytes at [dst] to [value] with the current kernel and fill
+// method.
+void kernel_fill(char* dst, long size, uint8_t value);
+
+// Scalar versions of the kernels, used by the others for the bytes that don't
+// fill a whole vector.
+void kernel_fill_tail(char* dst, long size, uint8_t value);
+void kernel_touch_tail(char* base, long size);
+void kernel_copy_tail(char* dst, const char* src, long size);
+uint64_t kernel_checksum_tail(const char* src, long size);
+
+// Measures the throughput of the kernels of every supported instruction set
+// on [size] bytes, best of [repeat] runs, and checks they agree. Returns the
+// process exit code.
+int kernel_bench(long size, int repeat);
+
+#endif
@@ -0,0 +1,78 @@
+#define _GNU_SOURCE
+
+#include "kernel.h"
+
+#ifdef KERNEL_NEON
+
+#include <arm_neon.h>
+#if defined(__linux__) && !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+// NEON is part of every ARMv8 CPU. 32-bit builds only get this kernel when
+// compiled with NEON enabled, and still check the CPU has it.
+static bool neon_supported() {
+#if defined(__linux__) && !defined(__aarch64__)
+    return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#else
+    return true;
+#endif
+}
+
+static void neon_fill(char* dst, long size, uint8_t value) {
+    uint8x16_t v = vdupq_n_u8(value);
+    long i = 0;
+    for(; i + 64 <= size; i += 64) {
+        vst1q_u8((uint8_t*)(dst + i), v);
+        vst1q_u8((uint8_t*)(dst + i + 16), v);
+        vst1q_u8((uint8_t*)(dst + i + 32), v);
+        vst1q_u8((uint8_t*)(dst + i + 48), v);
+    }
+    kernel_fill_tail(dst + i, size - i, value);
+}
+
+static void neon_touch(char* base, long size) {
+    long i = 0;
+    for(; i + 64 <= size; i += 64) {
+        uint8x16_t v = vld1q_u8((const uint8_t*)(base + i));
+        // Hide the value so writing back what was just read is not optimized
+        // away.
+        __asm__ volatile("" : "+w"(v));
+        vst1q_u8((uint8_t*)(base + i), v);
+    }
+    kernel_touch_tail(base + i, size - i);
+}
+
+static void neon_copy(char* dst, const char* src, long size) {
+    long i = 0;
+    for(; i + 64 <= size; i += 64) {
+        uint8x16_t a = vld1q_u8((const uint8_t*)(src + i));
+        uint8x16_t b = vld1q_u8((const uint8_t*)(src + i + 16));
+        uint8x16_t c = vld1q_u8((const uint8_t*)(src + i + 32));
+        uint8x16_t d = vld1q_u8((const uint8_t*)(src + i + 48));
+        vst1q_u8((uint8_t*)(dst + i), a);
+        vst1q_u8((uint8_t*)(dst + i + 16), b);
+        vst1q_u8((uint8_t*)(dst + i + 32), c);
+        vst1q_u8((uint8_t*)(dst + i + 48), d);
+    }
+    kernel_copy_tail(dst + i, src + i, size - i);
+}
+
+static uint64_t neon_checksum(const char* src, long size) {
+    uint64x2_t a = vdupq_n_u64(0);
+    uint64x2_t b = vdupq_n_u64(0);
+    long i = 0;
+    for(; i + 32 <= size; i += 32) {
+        a = vaddq_u64(a, vreinterpretq_u64_u8(vld1q_u8((const uint8_t*)(src + i))));
+        b = vaddq_u64(b, vreinterpretq_u64_u8(vld1q_u8((const uint8_t*)(src + i + 16))));
+    }
+    a = vaddq_u64(a, b);
+    return vgetq_lane_u64(a, 0) + vgetq_lane_u64(a, 1) + kernel_checksum_tail(src + i, size - i);
+}
+
+// NEON has no non-temporal store intrinsic, so it streams with ordinary
+// stores.
+const Kernel kernel_neon = { "neon", neon_supported, neon_fill, neon_fill, neon_touch, neon_copy, neon_checksum };
+
+#endif
@@ -0,0 +1,234 @@
+#define _GNU_SOURCE
+
+#include "kernel.h"
+
+#ifdef KERNEL_X86
+
+#include <stdint.h>
+#include <immintrin.h>
+
+// The vector kernels are compiled for their instruction set with target
+// attributes, so the rest of the program keeps running on any CPU.
+
+// Hides the value of [v] from the compiler so that writing back what was just
+// read is not optimized away.
+#define OPAQUE(v) __asm__ volatile("" : "+v"(v))
+
+static bool sse2_supported() {
+    return __builtin_cpu_supports("sse2");
+}
+
+__attribute__((target("sse2")))
+static void sse2_fill(char* dst, long size, uint8_t value) {
+    __m128i v = _mm_set1_epi8((char)value);
+    long i = 0;
+    for(; i + 64 <= size; i += 64) {
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+        _mm_storeu_si128((__m128i*)(dst + i + 16), v);
+        _mm_storeu_si128((__m128i*)(dst + i + 32), v);
+        _mm_storeu_si128((__m128i*)(dst + i + 48), v);
+    }
+    kernel_fill_tail(dst + i, size - i, value);
+}
+
+__attribute__((target("sse2")))
+static void sse2_touch(char* base, long size) {
+    long i = 0;
+    for(; i + 64 <= size; i += 64) {
+        __m128i v = _mm_loadu_si128((__m128i*)(base + i));
+        OPAQUE(v);
+        _mm_storeu_si128((__m128i*)(base + i), v);
+    }
+    kernel_touch_tail(base + i, size - i);
+}
+
+__attribute__((target("sse2")))
+static void sse2_copy(char* dst, const char* src, long size) {
+    long i = 0;
+    for(; i + 64 <= size; i += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(src + i + 32));
+        __m128i d = _mm_loadu_si128((const __m128i*)(src + i + 48));
+        _mm_storeu_si128((__m128i*)(dst + i), a);
+        _mm_storeu_si128((__m128i*)(dst + i + 16), b);
+        _mm_storeu_si128((__m128i*)(dst + i + 32), c);
+        _mm_storeu_si128((__m128i*)(dst + i + 48), d);
+    }
+    kernel_copy_tail(dst + i, src + i, size - i);
+}
+
+__attribute__((target("sse2")))
+static uint64_t sse2_checksum(const char* src, long size) {
+    __m128i a = _mm_setzero_si128();
+    __m128i b = _mm_setzero_si128();
+    long i = 0;
+    for(; i + 32 <= size; i += 32) {
+        a = _mm_add_epi64(a, _mm_loadu_si128((const __m128i*)(src + i)));
+        b = _mm_add_epi64(b, _mm_loadu_si128((const __m128i*)(src + i + 16)));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, _mm_add_epi64(a, b));
+    return lanes[0] + lanes[1] + kernel_checksum_tail(src + i, size - i);
+}
+
+// Non-temporal stores must be aligned, so the head is written with ordinary
+// stores up to the first aligned address.
+static long head(const char* dst, long size, long align) {
+    long misaligned = (long)((uintptr_t)dst & (align - 1));
+    long bytes = misaligned ? align - misaligned : 0;
+    return bytes < size ? bytes : size;
+}
+
+__attribute__((target("sse2")))
+static void sse2_stream(char* dst, long size, uint8_t value) {
+    __m128i v = _mm_set1_epi8((char)value);
+    long i = head(dst, size, 16);
+    kernel_fill_tail(dst, i, value);
+    for(; i + 64 <= size; i += 64) {
+        _mm_stream_si128((__m128i*)(dst + i), v);
+        _mm_stream_si128((__m128i*)(dst + i + 16), v);
+        _mm_stream_si128((__m128i*)(dst + i + 32), v);
+        _mm_stream_si128((__m128i*)(dst + i + 48), v);
+    }
+    _mm_sfence();
+    kernel_fill_tail(dst + i, size - i, value);
+}
+
+const Kernel kernel_sse2 = { "sse2", sse2_supported, sse2_fill, sse2_stream, sse2_touch, sse2_copy, sse2_checksum };
+
+static bool avx2_supported() {
+    return __builtin_cpu_supports("avx2");
+}
+
+__attribute__((target("avx2")))
+static void avx2_fill(char* dst, long size, uint8_t value) {
+    __m256i v = _mm256_set1_epi8((char)value);
+    long i = 0;
+    for(; i + 64 <= size; i += 64) {
+        _mm256_storeu_si256((__m256i*)(dst + i), v);
+        _mm256_storeu_si256((__m256i*)(dst + i + 32), v);
+    }
+    kernel_fill_tail(dst + i, size - i, value);
+}
+
+__attribute__((target("avx2")))
+static void avx2_touch(char* base, long size) {
+    long i = 0;
+    for(; i + 64 <= size; i += 64) {
+        __m256i v = _mm256_loadu_si256((__m256i*)(base + i));
+        OPAQUE(v);
+        _mm256_storeu_si256((__m256i*)(base + i), v);
+    }
+    kernel_touch_tail(base + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static void avx2_copy(char* dst, const char* src, long size) {
+    long i = 0;
+    for(; i + 64 <= size; i += 64) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 32));
+        _mm256_storeu_si256((__m256i*)(dst + i), a);
+        _mm256_storeu_si256((__m256i*)(dst + i + 32), b);
+    }
+    kernel_copy_tail(dst + i, src + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static uint64_t avx2_checksum(const char* src, long size) {
+    __m256i a = _mm256_setzero_si256();
+    __m256i b = _mm256_setzero_si256();
+    long i = 0;
+    for(; i + 64 <= size; i += 64) {
+        a = _mm256_add_epi64(a, _mm256_loadu_si256((const __m256i*)(src + i)));
+        b = _mm256_add_epi64(b, _mm256_loadu_si256((const __m256i*)(src + i + 32)));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, _mm256_add_epi64(a, b));
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + kernel_checksum_tail(src + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static void avx2_stream(char* dst, long size, uint8_t value) {
+    __m256i v = _mm256_set1_epi8((char)value);
+    long i = head(dst, size, 32);
+    kernel_fill_tail(dst, i, value);
+    for(; i + 64 <= size; i += 64) {
+        _mm256_stream_si256((__m256i*)(dst + i), v);
+        _mm256_stream_si256((__m256i*)(dst + i + 32), v);
+    }
+    _mm_sfence();
+    kernel_fill_tail(dst + i, size - i, value);
+}
+
+const Kernel kernel_avx2 = { "avx2", avx2_supported, avx2_fill, avx2_stream, avx2_touch, avx2_copy, avx2_checksum };
+
+static bool avx512_supported() {
+    return __builtin_cpu_supports("avx512f");
+}
+
+__attribute__((target("avx512f")))
+static void avx512_fill(char* dst, long size, uint8_t value) {
+    __m512i v = _mm512_set1_epi32((int)(value * 0x01010101U));
+    long i = 0;
+    for(; i + 64 <= size; i += 64) {
+        _mm512_storeu_si512((void*)(dst + i), v);
+    }
+    kernel_fill_tail(dst + i, size - i, value);
+}
+
+__attribute__((target("avx512f")))
+static void avx512_touch(char* base, long size) {
+    long i = 0;
+    for(; i + 64 <= size; i += 64) {
+        __m512i v = _mm512_loadu_si512((void*)(base + i));
+        OPAQUE(v);
+        _mm512_storeu_si512((void*)(base + i), v);
+    }
+    kernel_touch_tail(base + i, size - i);
+}
+
+__attribute__((target("avx512f")))
+static void avx512_copy(char* dst, const char* src, long size) {
+    long i = 0;
+    for(; i + 128 <= size; i += 128) {
+        __m512i a = _mm512_loadu_si512((const void*)(src + i));
+        __m512i b = _mm512_loadu_si512((const void*)(src + i + 64));
+        _mm512_storeu_si512((void*)(dst + i), a);
+        _mm512_storeu_si512((void*)(dst + i + 64), b);
+    }
+    kernel_copy_tail(dst + i, src + i, size - i);
+}
+
+__attribute__((target("avx512f")))
+static uint64_t avx512_checksum(const char* src, long size) {
+    __m512i a = _mm512_setzero_si512();
+    __m512i b = _mm512_setzero_si512();
+    long i = 0;
+    for(; i + 128 <= size; i += 128) {
+        a = _mm512_add_epi64(a, _mm512_loadu_si512((const void*)(src + i)));
+        b = _mm512_add_epi64(b, _mm512_loadu_si512((const void*)(src + i + 64)));
+    }
+    return (uint64_t)_mm512_reduce_add_epi64(_mm512_add_epi64(a, b)) + kernel_checksum_tail(src + i, size - i);
+}
+
+__attribute__((target("avx512f")))
+static void avx512_stream(char* dst, long size, uint8_t value) {
+    __m512i v = _mm512_set1_epi32((int)(value * 0x01010101U));
+    long i = head(dst, size, 64);
+    kernel_fill_tail(dst, i, value);
+    for(; i + 64 <= size; i += 64) {
+        _mm512_stream_si512((void*)(dst + i), v);
+    }
+    _mm_sfence();
+    kernel_fill_tail(dst + i, size - i, value);
+}
+
+const Kernel kernel_avx512 = { "avx512", avx512_supported, avx512_fill, avx512_stream, avx512_touch, avx512_copy, avx512_checksum };
+
+void kernel_stosb(char* dst, long size, uint8_t value) {
+    __asm__ volatile("rep stosb" : "+D"(dst), "+c"(size) : "a"(value) : "memory");
+}
+
+#endif
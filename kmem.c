@@ -0,0 +1,151 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include "kmem.h"
+#include "util.h"
+
+// Size of each write to a socket, small enough for the data to stay in the
+// slab-allocated head of its socket buffer.
+#define KMEM_SOCKET_WRITE 3072
+
+// Largest pipe requested, the default /proc/sys/fs/pipe-max-size.
+#define KMEM_PIPE_SIZE (1 << 20)
+
+void kmem_init(KernelMemory* kmem) {
+    memset(kmem, 0, sizeof(KernelMemory));
+    struct rlimit limit;
+    if(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+static bool open_buffer(KernelBuffer* buffer, bool socket) {
+    buffer->socket = socket;
+    buffer->bytes = 0;
+    if(socket) {
+        if(socketpair(AF_UNIX, SOCK_STREAM, 0, buffer->fds) != 0) {
+            return false;
+        }
+        int size = 1 << 30;
+        // Capped at net.core.wmem_max.
+        setsockopt(buffer->fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    } else {
+        if(pipe(buffer->fds) != 0) {
+            return false;
+        }
+#ifdef F_SETPIPE_SZ
+        // Unprivileged pipes past the per user limit stay small.
+        fcntl(buffer->fds[1], F_SETPIPE_SZ, KMEM_PIPE_SIZE);
+#endif
+    }
+    fcntl(buffer->fds[1], F_SETFL, O_NONBLOCK);
+    return true;
+}
+
+static void close_buffer(KernelBuffer* buffer) {
+    close(buffer->fds[0]);
+    close(buffer->fds[1]);
+}
+
+// Writes up to [bytes] bytes to [buffer] until it is full. Returns false if
+// nothing could be written.
+static bool fill_buffer(KernelBuffer* buffer, long long bytes) {
+    static char data[KMEM_SOCKET_WRITE * 4];
+    long long start = buffer->bytes;
+    while(buffer->bytes - start < bytes) {
+        long long left = bytes - (buffer->bytes - start);
+        size_t len = buffer->socket ? KMEM_SOCKET_WRITE : sizeof(data);
+        ssize_t written = write(buffer->fds[1], data, left < (long long)len ? (size_t)left : len);
+        if(written <= 0) {
+            break;
+        }
+        buffer->bytes += written;
+    }
+    return buffer->bytes > start;
+}
+
+int kmem_grow(KernelMemory* kmem, long long bytes) {
+    long long target = kmem->size + bytes;
+    while(kmem->size < target) {
+        if(kmem->count == kmem->capacity) {
+            long capacity = kmem->capacity ? kmem->capacity * 2 : 64;
+            KernelBuffer* buffers = realloc(kmem->buffers, capacity * sizeof(KernelBuffer));
+            if(buffers == NULL) {
+                return -1;
+            }
+            kmem->buffers = buffers;
+            kmem->capacity = capacity;
+        }
+        KernelBuffer* buffer = &kmem->buffers[kmem->count];
+        if(!open_buffer(buffer, kmem->count % 2 == 1)) {
+            return -1;
+        }
+        if(!fill_buffer(buffer, target - kmem->size)) {
+            close_buffer(buffer);
+            return -1;
+        }
+        kmem->count++;
+        kmem->size += buffer->bytes;
+    }
+    return 0;
+}
+
+void kmem_shrink(KernelMemory* kmem, long long bytes) {
+    long long target = kmem->size - bytes;
+    while(kmem->count > 0 && kmem->size > target) {
+        KernelBuffer* buffer = &kmem->buffers[--kmem->count];
+        kmem->size -= buffer->bytes;
+        close_buffer(buffer);
+    }
+}
+
+long long kmem_release(KernelMemory* kmem) {
+    long long start = now_ns();
+    kmem_shrink(kmem, kmem->size);
+    free(kmem->buffers);
+    kmem->buffers = NULL;
+    kmem->capacity = 0;
+    return now_ns() - start;
+}
+
+static long long meminfo_bytes(const char* key) {
+    long long kb = read_keyed_value("/proc/meminfo", key);
+    return kb < 0 ? -1 : kb * 1024;
+}
+
+void kernel_usage(KernelUsage* usage) {
+    usage->slab = meminfo_bytes("Slab");
+    usage->unreclaimable = meminfo_bytes("SUnreclaim");
+    usage->kernel_stack = meminfo_bytes("KernelStack");
+    usage->cgroup_kernel = -1;
+    char path[512];
+    if(cgroup_memory_file("memory.stat", NULL, path, sizeof(path))) {
+        usage->cgroup_kernel = read_keyed_value(path, "kernel");
+    } else if(cgroup_memory_file(NULL, "memory.kmem.usage_in_bytes", path, sizeof(path))) {
+        usage->cgroup_kernel = read_value(path);
+    }
+}
+
+static void print_delta(const char* name, long long before, long long after) {
+    if(before < 0 || after < 0) {
+        printf("%-14s %12s\n", name, "n/a");
+    } else {
+        printf("%-14s %+12lld kB\n", name, (after - before) / 1024);
+    }
+}
+
+void kernel_usage_print(const KernelUsage* before, const KernelUsage* after) {
+    print_delta("Slab", before->slab, after->slab);
+    print_delta("SUnreclaim", before->unreclaimable, after->unreclaimable);
+    print_delta("KernelStack", before->kernel_stack, after->kernel_stack);
+    print_delta("cgroup kernel", before->cgroup_kernel, after->cgroup_kernel);
+}
@@ -0,0 +1,57 @@
+#ifndef kmem_h
+#define kmem_h
+
+#include <stdbool.h>
+
+// One pipe or connected socket pair whose buffers hold unread data.
+typedef struct {
+    int fds[2];
+    bool socket;
+    long long bytes;
+} KernelBuffer;
+
+// Kernel memory eaten by writing to pipes and unix stream sockets and never
+// reading the data back. Pipe buffer pages and socket buffers are charged to
+// the cgroup's kernel memory, and socket buffers show up in the unreclaimable
+// slab.
+typedef struct {
+    KernelBuffer* buffers;
+    long count;
+    long capacity;
+    // Bytes of data queued in all the buffers.
+    long long size;
+} KernelMemory;
+
+// Kernel memory counters, in bytes, or -1 when unknown.
+typedef struct {
+    long long slab;
+    long long unreclaimable;
+    long long kernel_stack;
+    // Kernel memory charged to this process's cgroup.
+    long long cgroup_kernel;
+} KernelUsage;
+
+// Initializes [kmem] empty and raises the open files limit as far as allowed,
+// as every buffer takes two file descriptors.
+void kmem_init(KernelMemory* kmem);
+
+// Queues [bytes] more bytes, alternating between pipes enlarged as far as
+// allowed and socket pairs. Returns 0 on success and -1 if a buffer could not
+// be created or filled, e.g. when out of file descriptors or when the cgroup's
+// kernel memory is exhausted; whatever was queued before is kept.
+int kmem_grow(KernelMemory* kmem, long long bytes);
+
+// Closes the last buffers until [bytes] bytes are freed, or all of them.
+void kmem_shrink(KernelMemory* kmem, long long bytes);
+
+// Closes all the buffers, leaving [kmem] empty and usable. Returns the elapsed
+// nanoseconds.
+long long kmem_release(KernelMemory* kmem);
+
+// Reads the kernel memory counters from /proc/meminfo and the cgroup.
+void kernel_usage(KernelUsage* usage);
+
+// Prints how much each counter grew from [before] to [after].
+void kernel_usage_print(const KernelUsage* before, const KernelUsage* after);
+
+#endif
@@ -0,0 +1,193 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include "handle.h"
+#include "kernel.h"
+#include "release.h"
+#include "util.h"
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#if defined(_SC_PHYS_PAGES) && defined(_SC_AVPHYS_PAGES) && defined(_SC_PAGE_SIZE)
+#define MEMORY_PERCENTAGE
+#endif
+
+EatMemory* em_new(int chunk) {
+    EatMemory* em = malloc(sizeof(EatMemory));
+    if(em == NULL) {
+        return NULL;
+    }
+    em->chunk = chunk > 0 ? chunk : 0;
+    em->chunks = NULL;
+    em->chunk_count = 0;
+    em->chunk_capacity = 0;
+    extents_init(&em->extents);
+    em->grow_ns = 0;
+    em->shrink_ns = 0;
+    em->touch_ns = 0;
+    return em;
+}
+
+void em_free(EatMemory* em) {
+    if(em == NULL) {
+        return;
+    }
+    em_release(em, em->chunk ? "free" : "munmap", 1);
+    free(em);
+}
+
+static int grow_chunks(EatMemory* em, long long bytes) {
+    long count = (bytes + em->chunk - 1) / em->chunk;
+    if(em->chunk_count + count > em->chunk_capacity) {
+        long capacity = em->chunk_capacity * 2 > em->chunk_count + count ? em->chunk_capacity * 2 : em->chunk_count + count;
+        short** chunks = realloc(em->chunks, sizeof(short*) * capacity);
+        if(chunks == NULL) {
+            return -1;
+        }
+        em->chunks = chunks;
+        em->chunk_capacity = capacity;
+    }
+    for(long i = 0; i < count; i++) {
+        short* buffer = malloc(em->chunk);
+        if(buffer == NULL) {
+            return -1;
+        }
+        kernel_fill((char*)buffer, em->chunk, 0);
+        em->chunks[em->chunk_count++] = buffer;
+    }
+    return 0;
+}
+
+static int grow_extents(EatMemory* em, long long bytes) {
+    long long target = em->extents.total + bytes;
+    while(em->extents.total < target) {
+        long long left = target - em->extents.total;
+        if(!extents_grow(&em->extents, left < EXTENT_SIZE ? left : EXTENT_SIZE)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int em_grow(EatMemory* em, long long bytes) {
+    long long start = now_ns();
+    int status = bytes <= 0 ? 0 : em->chunk ? grow_chunks(em, bytes) : grow_extents(em, bytes);
+    em->grow_ns += now_ns() - start;
+    return status;
+}
+
+int em_shrink(EatMemory* em, long long bytes) {
+    long long start = now_ns();
+    if(em->chunk) {
+        long count = (bytes + em->chunk - 1) / em->chunk;
+        while(count-- > 0 && em->chunk_count > 0) {
+            free(em->chunks[--em->chunk_count]);
+        }
+#ifdef __GLIBC__
+        // Freeing small chunks never shrinks the heap by itself.
+        malloc_trim(0);
+#endif
+    } else {
+        long long target = em->extents.total - bytes;
+        extents_truncate(&em->extents, target > 0 ? target : 0);
+    }
+    em->shrink_ns += now_ns() - start;
+    return 0;
+}
+
+// Rewrites the first byte of every page of [size] bytes at [base] with its
+// own value.
+static void rewrite_pages(volatile char* base, long size, long page) {
+    for(long offset = 0; offset < size; offset += page) {
+        base[offset] = base[offset];
+    }
+}
+
+void em_touch(EatMemory* em) {
+    long long start = now_ns();
+    long page = sysconf(_SC_PAGE_SIZE);
+    for(long i = 0; i < em->chunk_count; i++) {
+        rewrite_pages((volatile char*)em->chunks[i], em->chunk, page);
+    }
+    for(long i = 0; i < em->extents.count; i++) {
+        rewrite_pages(em->extents.bases[i], em->extents.sizes[i], page);
+    }
+    em->touch_ns += now_ns() - start;
+}
+
+void em_stats(EatMemory* em, EatMemoryStats* stats) {
+    stats->size = em->chunk ? (long long)em->chunk_count * em->chunk : em->extents.total;
+    stats->blocks = em->chunk ? em->chunk_count : em->extents.count;
+    stats->resident = rss_bytes();
+    stats->grow_ns = em->grow_ns;
+    stats->shrink_ns = em->shrink_ns;
+    stats->touch_ns = em->touch_ns;
+}
+
+long long em_release(EatMemory* em, const char* method, int threads) {
+    int m = release_method(method);
+    if(m < 0 || (m == RELEASE_FREE) != (em->chunk > 0)) {
+        return -1;
+    }
+    if(em->chunk) {
+        long long elapsed = em->chunks ? release_chunks(em->chunks, (long)em->chunk_count * em->chunk, em->chunk, threads) : 0;
+        em->chunks = NULL;
+        em->chunk_count = 0;
+        em->chunk_capacity = 0;
+        return elapsed;
+    }
+    return release_extents(&em->extents, m, threads);
+}
+
+long long em_parse_size(const char* text) {
+    size_t len = strlen(text);
+    if(len == 0) {
+        return -1;
+    }
+    char unit = text[len - 1];
+    errno = 0;
+    long long value = strtoll(text, NULL, 10);
+    if(errno == ERANGE || value < 0) {
+        return -1;
+    } else if(isdigit(unit)) {
+        return value;
+    } else if(unit == 'M' || unit == 'G') {
+        long long multiplier = unit == 'M' ? 1024LL * 1024 : 1024LL * 1024 * 1024;
+        return value > LLONG_MAX / multiplier ? -1 : value * multiplier;
+    }
+#ifdef MEMORY_PERCENTAGE
+    else if(unit == '%') {
+        long long free_memory = em_free_system_memory();
+        return free_memory > 0 && value > LLONG_MAX / free_memory ? -1 : value * free_memory / 100;
+    }
+#endif
+    return -1;
+}
+
+long long em_total_system_memory(void) {
+#ifdef MEMORY_PERCENTAGE
+    return (long long)sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGE_SIZE);
+#else
+    return -1;
+#endif
+}
+
+long long em_free_system_memory(void) {
+#ifdef MEMORY_PERCENTAGE
+    return (long long)sysconf(_SC_AVPHYS_PAGES) * sysconf(_SC_PAGE_SIZE);
+#else
+    return -1;
+#endif
+}
+
+const char* em_version(void) {
+    return EATMEMORY_VERSION;
+}
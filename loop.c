@@ -0,0 +1,293 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include "loop.h"
+#include "util.h"
+
+#ifdef EVENT_LOOP
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#endif
+
+typedef struct {
+    bool used;
+    bool timer;
+    int fd;
+    long long interval_ns;
+    // Next expiry of a timer, without timerfd.
+    long long next_ns;
+    loop_callback_t callback;
+    void* data;
+} Source;
+
+struct Loop {
+    Source sources[LOOP_MAX_SOURCES];
+    bool stopped;
+    int signal;
+#ifdef EVENT_LOOP
+    int epoll_fd;
+    int signal_fd;
+    sigset_t old_mask;
+#else
+    int pipe_fds[2];
+    struct sigaction old_int;
+    struct sigaction old_term;
+#endif
+};
+
+#ifndef EVENT_LOOP
+// Write end of the self-pipe of the running loop, for the signal handler.
+static int signal_pipe = -1;
+
+static void on_signal(int sig) {
+    unsigned char c = (unsigned char)sig;
+    if(write(signal_pipe, &c, 1) < 0) {
+        // Nothing to do from a signal handler; the pipe is full anyway.
+    }
+}
+#endif
+
+Loop* loop_new() {
+    Loop* loop = calloc(1, sizeof(Loop));
+    if(loop == NULL) {
+        return NULL;
+    }
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+#ifdef EVENT_LOOP
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    pthread_sigmask(SIG_BLOCK, &mask, &loop->old_mask);
+    loop->signal_fd = signalfd(-1, &mask, SFD_CLOEXEC);
+    struct epoll_event event = {.events = EPOLLIN, .data.u32 = LOOP_MAX_SOURCES};
+    if(loop->epoll_fd < 0 || loop->signal_fd < 0 || epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->signal_fd, &event) != 0) {
+        loop_free(loop);
+        return NULL;
+    }
+#else
+    if(pipe(loop->pipe_fds) != 0) {
+        free(loop);
+        return NULL;
+    }
+    fcntl(loop->pipe_fds[1], F_SETFL, O_NONBLOCK);
+    signal_pipe = loop->pipe_fds[1];
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, &loop->old_int);
+    sigaction(SIGTERM, &sa, &loop->old_term);
+#endif
+    return loop;
+}
+
+static int add_source(Loop* loop, int fd, bool timer, long long interval_ns, loop_callback_t callback, void* data) {
+    for(int id = 0; id < LOOP_MAX_SOURCES; id++) {
+        Source* s = &loop->sources[id];
+        if(s->used) {
+            continue;
+        }
+#ifdef EVENT_LOOP
+        struct epoll_event event = {.events = EPOLLIN, .data.u32 = id};
+        if(epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            return -1;
+        }
+#endif
+        s->used = true;
+        s->timer = timer;
+        s->fd = fd;
+        s->interval_ns = interval_ns;
+        s->callback = callback;
+        s->data = data;
+        return id;
+    }
+    return -1;
+}
+
+int loop_add_timer(Loop* loop, long long delay_ns, long long interval_ns, loop_callback_t callback, void* data) {
+    // A zero delay would disarm a timerfd.
+    delay_ns = delay_ns > 0 ? delay_ns : 1;
+#ifdef EVENT_LOOP
+    // Non-blocking, as a stale event for a reused id must not wait for the
+    // new timer to expire.
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    struct itimerspec spec = {
+        {interval_ns / 1000000000LL, interval_ns % 1000000000LL},
+        {delay_ns / 1000000000LL, delay_ns % 1000000000LL}
+    };
+    if(fd < 0 || timerfd_settime(fd, 0, &spec, NULL) != 0) {
+        if(fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    int id = add_source(loop, fd, true, interval_ns, callback, data);
+    if(id < 0) {
+        close(fd);
+    }
+    return id;
+#else
+    int id = add_source(loop, -1, true, interval_ns, callback, data);
+    if(id >= 0) {
+        loop->sources[id].next_ns = now_ns() + delay_ns;
+    }
+    return id;
+#endif
+}
+
+int loop_add_fd(Loop* loop, int fd, loop_callback_t callback, void* data) {
+    return add_source(loop, fd, false, 0, callback, data);
+}
+
+void loop_remove(Loop* loop, int id) {
+    if(id < 0 || id >= LOOP_MAX_SOURCES || !loop->sources[id].used) {
+        return;
+    }
+    Source* s = &loop->sources[id];
+#ifdef EVENT_LOOP
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, s->fd, NULL);
+    if(s->timer) {
+        close(s->fd);
+    }
+#endif
+    s->used = false;
+}
+
+// Runs the callback of source [id] and rearms or removes it if it is a timer.
+static void fire(Loop* loop, int id) {
+    Source* s = &loop->sources[id];
+    if(!s->used) {
+        return;
+    }
+    if(s->timer) {
+#ifdef EVENT_LOOP
+        // Fails with EAGAIN if the timer has not actually fired.
+        unsigned long long expirations;
+        if(read(s->fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+            return;
+        }
+#else
+        s->next_ns += s->interval_ns;
+#endif
+    }
+    loop_callback_t callback = s->callback;
+    void* data = s->data;
+    if(s->timer && s->interval_ns == 0) {
+        loop_remove(loop, id);
+    }
+    callback(loop, data);
+}
+
+#ifdef EVENT_LOOP
+
+int loop_run(Loop* loop) {
+    loop->stopped = false;
+    while(!loop->stopped) {
+        struct epoll_event events[LOOP_MAX_SOURCES + 1];
+        int n = epoll_wait(loop->epoll_fd, events, LOOP_MAX_SOURCES + 1, -1);
+        if(n < 0 && errno != EINTR) {
+            break;
+        }
+        for(int i = 0; i < n && !loop->stopped; i++) {
+            if(events[i].data.u32 == LOOP_MAX_SOURCES) {
+                struct signalfd_siginfo info;
+                if(read(loop->signal_fd, &info, sizeof(info)) == sizeof(info)) {
+                    loop->signal = info.ssi_signo;
+                    loop->stopped = true;
+                }
+            } else {
+                fire(loop, events[i].data.u32);
+            }
+        }
+    }
+    return loop->signal;
+}
+
+#else
+
+int loop_run(Loop* loop) {
+    loop->stopped = false;
+    while(!loop->stopped) {
+        struct pollfd fds[LOOP_MAX_SOURCES + 1];
+        int ids[LOOP_MAX_SOURCES + 1];
+        int n = 0;
+        long long next = -1;
+        fds[n].fd = loop->pipe_fds[0];
+        fds[n].events = POLLIN;
+        ids[n++] = LOOP_MAX_SOURCES;
+        for(int id = 0; id < LOOP_MAX_SOURCES; id++) {
+            Source* s = &loop->sources[id];
+            if(s->used && s->timer) {
+                next = next < 0 || s->next_ns < next ? s->next_ns : next;
+            } else if(s->used) {
+                fds[n].fd = s->fd;
+                fds[n].events = POLLIN;
+                ids[n++] = id;
+            }
+        }
+        long long wait = next < 0 ? -1 : next - now_ns();
+        int ready = poll(fds, n, wait < 0 && next >= 0 ? 0 : wait < 0 ? -1 : (int)((wait + 999999) / 1000000));
+        if(ready < 0 && errno != EINTR) {
+            break;
+        }
+        for(int i = 0; i < n && ready > 0 && !loop->stopped; i++) {
+            if(!(fds[i].revents & (POLLIN | POLLHUP))) {
+                continue;
+            }
+            if(ids[i] == LOOP_MAX_SOURCES) {
+                unsigned char c;
+                if(read(loop->pipe_fds[0], &c, 1) == 1) {
+                    loop->signal = c;
+                    loop->stopped = true;
+                }
+            } else {
+                fire(loop, ids[i]);
+            }
+        }
+        long long now = now_ns();
+        for(int id = 0; id < LOOP_MAX_SOURCES && !loop->stopped; id++) {
+            if(loop->sources[id].used && loop->sources[id].timer && loop->sources[id].next_ns <= now) {
+                fire(loop, id);
+            }
+        }
+    }
+    return loop->signal;
+}
+
+#endif
+
+void loop_stop(Loop* loop) {
+    loop->stopped = true;
+}
+
+void loop_free(Loop* loop) {
+    for(int id = 0; id < LOOP_MAX_SOURCES; id++) {
+        loop_remove(loop, id);
+    }
+#ifdef EVENT_LOOP
+    if(loop->signal_fd >= 0) {
+        close(loop->signal_fd);
+    }
+    if(loop->epoll_fd >= 0) {
+        close(loop->epoll_fd);
+    }
+    pthread_sigmask(SIG_SETMASK, &loop->old_mask, NULL);
+#else
+    sigaction(SIGINT, &loop->old_int, NULL);
+    sigaction(SIGTERM, &loop->old_term, NULL);
+    signal_pipe = -1;
+    close(loop->pipe_fds[0]);
+    close(loop->pipe_fds[1]);
+#endif
+    free(loop);
+}
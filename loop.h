@@ -0,0 +1,44 @@
+#ifndef loop_h
+#define loop_h
+
+#ifdef __linux__
+#define EVENT_LOOP
+#endif
+
+// Maximum number of timers and file descriptors watched by a loop.
+#define LOOP_MAX_SOURCES 16
+
+// Runs callbacks for timers, readable file descriptors and SIGINT/SIGTERM
+// from a single thread, sleeping in between. On Linux it is built on epoll,
+// timerfd and signalfd, and otherwise on poll() and a signal handler. A loop
+// with nothing to do never wakes up.
+typedef struct Loop Loop;
+
+typedef void (*loop_callback_t)(Loop* loop, void* data);
+
+// Allocates a new loop and starts catching SIGINT and SIGTERM, which stop it.
+// Returns NULL if it could not be set up.
+Loop* loop_new();
+
+// Calls [callback] [delay_ns] from now, then every [interval_ns] if it is not
+// zero. Returns the source's id, or -1 if it could not be added.
+int loop_add_timer(Loop* loop, long long delay_ns, long long interval_ns, loop_callback_t callback, void* data);
+
+// Calls [callback] whenever [fd] is readable. Returns the source's id, or -1
+// if it could not be added.
+int loop_add_fd(Loop* loop, int fd, loop_callback_t callback, void* data);
+
+// Stops watching the source [id].
+void loop_remove(Loop* loop, int id);
+
+// Runs the callbacks as their sources fire until loop_stop() is called or a
+// SIGINT or SIGTERM arrives. Returns the signal, or 0.
+int loop_run(Loop* loop);
+
+// Makes loop_run() return once the current callback is done.
+void loop_stop(Loop* loop);
+
+// Frees the loop and restores the handling of SIGINT and SIGTERM.
+void loop_free(Loop* loop);
+
+#endif
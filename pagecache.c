@@ -0,0 +1,159 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "pagecache.h"
+#include "util.h"
+
+#define IO_BLOCK (1024 * 1024)
+#define MINCORE_WINDOW (1024L * 1024 * 1024)
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void request_stop(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static int write_file(int fd, long total) {
+    char* block = malloc(IO_BLOCK);
+    if(block == NULL) {
+        return -1;
+    }
+    // Non-zero data so filesystems can't keep the file sparse.
+    memset(block, 0xa5, IO_BLOCK);
+    for(long done = 0; done < total; ) {
+        long len = total - done < IO_BLOCK ? total - done : IO_BLOCK;
+        ssize_t written = write(fd, block, len);
+        if(written <= 0) {
+            free(block);
+            return -1;
+        }
+        done += written;
+    }
+    free(block);
+    // Write back now so the cache holds clean pages, like a file read from disk.
+    return fsync(fd);
+}
+
+// Returns the number of pages of the mapping that are resident, scanning it in
+// windows so the mincore() vector stays small for large files.
+static long resident_pages(char* map, long total, long page) {
+    long window_pages = MINCORE_WINDOW / page;
+    unsigned char* vec = malloc(window_pages);
+    if(vec == NULL) {
+        return -1;
+    }
+    long resident = 0;
+    for(long offset = 0; offset < total; offset += MINCORE_WINDOW) {
+        long len = total - offset < MINCORE_WINDOW ? total - offset : MINCORE_WINDOW;
+        if(mincore(map + offset, len, (void*)vec) != 0) {
+            free(vec);
+            return -1;
+        }
+        for(long i = 0; i < (len + page - 1) / page; i++) {
+            resident += vec[i] & 1;
+        }
+    }
+    free(vec);
+    return resident;
+}
+
+static int reread(int fd, char* map, long total, long page, bool use_mmap) {
+    volatile char sink = 0;
+    if(use_mmap) {
+        for(long i = 0; i < total; i += page) {
+            sink += map[i];
+        }
+        return 0;
+    }
+    char* block = malloc(IO_BLOCK);
+    if(block == NULL) {
+        return -1;
+    }
+    for(long done = 0; done < total; ) {
+        ssize_t n = pread(fd, block, IO_BLOCK, done);
+        if(n <= 0) {
+            free(block);
+            return -1;
+        }
+        done += n;
+    }
+    free(block);
+    return 0;
+}
+
+int eat_page_cache(long total, const char* path, bool use_mmap, int interval, int timeout) {
+    long page = sysconf(_SC_PAGE_SIZE);
+    // The file is removed on exit, so it must not be one that already exists.
+    int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if(fd < 0 && errno == EEXIST) {
+        printf("ERROR: %s already exists, give the path of a new scratch file\n", path);
+        return 1;
+    } else if(fd < 0) {
+        perror(path);
+        return 1;
+    }
+    int status = 1;
+    long long cached_before = read_keyed_value("/proc/meminfo", "Cached");
+    long long start = now_ns();
+    if(write_file(fd, total) != 0) {
+        printf("ERROR: Could not write the scratch file\n");
+        goto out;
+    }
+    printf("Wrote %ld bytes in %.1f ms\n", total, (now_ns() - start) / 1e6);
+
+    // The mapping is always needed for mincore(); the mmap method also reads
+    // through it.
+    char* map = mmap(NULL, total, PROT_READ, MAP_SHARED, fd, 0);
+    if(map == MAP_FAILED) {
+        perror("mmap");
+        goto out;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = request_stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    long pages = (total + page - 1) / page;
+    long long deadline = timeout >= 0 ? start + timeout * 1000000000LL : -1;
+    printf("%8s  %10s  %10s  %12s\n", "TIME_S", "HIT_RATE", "REREAD_MS", "CACHED_DELTA");
+    status = 0;
+    while(!stop_requested) {
+        long resident = resident_pages(map, total, page);
+        long long pass_start = now_ns();
+        if(reread(fd, map, total, page, use_mmap) != 0) {
+            printf("ERROR: Could not read the scratch file\n");
+            status = 1;
+            break;
+        }
+        long long pass_end = now_ns();
+        long long cached = read_keyed_value("/proc/meminfo", "Cached");
+        printf("%8.1f  %9.1f%%  %10.1f  %9lld kB\n", (pass_start - start) / 1e9,
+            resident < 0 ? 0 : 100.0 * resident / pages, (pass_end - pass_start) / 1e6,
+            cached >= 0 && cached_before >= 0 ? cached - cached_before : 0);
+        fflush(stdout);
+        if(deadline >= 0 && pass_end >= deadline) {
+            break;
+        }
+        long long wait = interval * 1000000000LL;
+        if(deadline >= 0 && deadline - pass_end < wait) {
+            wait = deadline - pass_end;
+        }
+        sleep_ns(wait, &stop_requested);
+    }
+    munmap(map, total);
+out:
+    close(fd);
+    unlink(path);
+    return status;
+}
@@ -0,0 +1,14 @@
+#ifndef pagecache_h
+#define pagecache_h
+
+#include <stdbool.h>
+
+// Fills the page cache with a [total] byte scratch file at [path] and keeps it
+// hot by re-reading it every [interval] seconds, either with buffered reads or
+// through a shared mapping ([use_mmap]). Before each pass it reports how much
+// of the file is still resident according to mincore(). Runs for [timeout]
+// seconds, or until interrupted if negative, and removes the file on exit.
+// Refuses to overwrite a file that already exists at [path]. Returns the process exit code.
+int eat_page_cache(long total, const char* path, bool use_mmap, int interval, int timeout);
+
+#endif
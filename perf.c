@@ -0,0 +1,140 @@
+#define _GNU_SOURCE
+
+#include "perf.h"
+
+#include <stdio.h>
+#include "util.h"
+
+// Index of the task clock, which is reported in milliseconds.
+#define TASK_CLOCK 0
+
+static const char* event_labels[PERF_EVENTS] = {
+    "TASK_MS", "FAULTS", "MINOR", "MAJOR", "DTLB_MISS", "LLC_MISS", "CYCLES", "INSTR"
+};
+
+#ifdef PERF_COUNTERS
+
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+// In the same order as event_labels.
+static const struct {
+    unsigned int type;
+    unsigned long long config;
+} events[PERF_EVENTS] = {
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MIN},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MAJ},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+};
+
+static int open_event(unsigned int type, unsigned long long config, bool kernel) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = !kernel;
+    attr.exclude_hv = 1;
+    attr.inherit = 1;
+    int fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    return fd < 0 ? -1 : fd;
+}
+
+int perf_open(unsigned int type, unsigned long long config) {
+    return open_event(type, config, false);
+}
+
+long long perf_read(int fd) {
+    long long value;
+    if(fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value)) {
+        return -1;
+    }
+    return value;
+}
+
+void perf_close(int fd) {
+    if(fd >= 0) {
+        close(fd);
+    }
+}
+
+int perf_open_dtlb_misses() {
+    return perf_open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+}
+
+void perf_begin(PerfCounters* counters, bool enabled) {
+    for(int i = 0; i < PERF_EVENTS; i++) {
+        if(!enabled) {
+            counters->fds[i] = -1;
+            counters->start[i] = -1;
+            continue;
+        }
+        // Filling and releasing memory happens mostly in the kernel, so count
+        // it where allowed and fall back to user space only otherwise.
+        counters->fds[i] = open_event(events[i].type, events[i].config, true);
+        if(counters->fds[i] < 0) {
+            counters->fds[i] = open_event(events[i].type, events[i].config, false);
+        }
+        counters->start[i] = perf_read(counters->fds[i]);
+    }
+    counters->start_ns = now_ns();
+}
+
+void perf_end(PerfCounters* counters, PerfPhase* phase, const char* name) {
+    phase->ns = now_ns() - counters->start_ns;
+    phase->name = name;
+    for(int i = 0; i < PERF_EVENTS; i++) {
+        long long value = perf_read(counters->fds[i]);
+        phase->values[i] = value >= 0 && counters->start[i] >= 0 ? value - counters->start[i] : -1;
+        perf_close(counters->fds[i]);
+    }
+}
+
+#else
+
+void perf_begin(PerfCounters* counters, bool enabled) {
+    (void)enabled;
+    counters->start_ns = now_ns();
+}
+
+void perf_end(PerfCounters* counters, PerfPhase* phase, const char* name) {
+    phase->ns = now_ns() - counters->start_ns;
+    phase->name = name;
+    for(int i = 0; i < PERF_EVENTS; i++) {
+        phase->values[i] = -1;
+    }
+}
+
+#endif
+
+void perf_print(const PerfPhase* phases, int count) {
+    printf("%-8s  %10s", "PHASE", "TIME_MS");
+    for(int i = 0; i < PERF_EVENTS; i++) {
+        printf("  %12s", event_labels[i]);
+    }
+    printf("\n");
+    for(int p = 0; p < count; p++) {
+        printf("%-8s  %10.1f", phases[p].name, phases[p].ns / 1e6);
+        for(int i = 0; i < PERF_EVENTS; i++) {
+            long long value = phases[p].values[i];
+            if(value < 0) {
+                printf("  %12s", "n/a");
+            } else if(i == TASK_CLOCK) {
+                printf("  %12.1f", value / 1e6);
+            } else {
+                printf("  %12lld", value);
+            }
+        }
+        printf("\n");
+    }
+}
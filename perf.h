@@ -0,0 +1,55 @@
+#ifndef perf_h
+#define perf_h
+
+#ifdef __linux__
+#define PERF_COUNTERS
+#endif
+
+#ifdef PERF_COUNTERS
+
+// Opens a perf_event_open() counter of [type] and [config] for the calling
+// thread, counting user space only, and starts it. Returns -1 if the event is
+// not available, e.g. hardware events inside most VMs.
+int perf_open(unsigned int type, unsigned long long config);
+
+// Returns the counter's current value, or -1 if it could not be read.
+long long perf_read(int fd);
+
+// Closes a counter; does nothing for -1.
+void perf_close(int fd);
+
+// Opens a counter of data TLB load misses. Returns -1 if not available.
+int perf_open_dtlb_misses();
+
+#endif
+
+#include <stdbool.h>
+
+#define PERF_EVENTS 8
+
+// Counters around one phase of a run. Software events (faults, task clock)
+// are almost always available; hardware events are -1 where the PMU is not
+// exposed, as in most VMs, and every event is -1 without PERF_COUNTERS.
+typedef struct {
+    const char* name;
+    long long ns;
+    long long values[PERF_EVENTS];
+} PerfPhase;
+
+typedef struct {
+    int fds[PERF_EVENTS];
+    long long start[PERF_EVENTS];
+    long long start_ns;
+} PerfCounters;
+
+// Opens and starts the counters for the calling thread and the threads it
+// creates from now on. Only the elapsed time is measured if not [enabled].
+void perf_begin(PerfCounters* counters, bool enabled);
+
+// Stops the counters and stores their deltas in [phase] under [name].
+void perf_end(PerfCounters* counters, PerfPhase* phase, const char* name);
+
+// Prints the phases as a table, with n/a for unavailable events.
+void perf_print(const PerfPhase* phases, int count);
+
+#endif
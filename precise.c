@@ -0,0 +1,69 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "eatmemory.h"
+#include "precise.h"
+#include "util.h"
+
+// Adjustments made before giving up, e.g. if freed chunks stay in the heap.
+#define SETTLE_ROUNDS 16
+
+int precise_measure(const char* name) {
+    if(strcmp(name, "rss") == 0) {
+        return PRECISE_RSS;
+    } else if(strcmp(name, "cgroup") == 0) {
+        return PRECISE_CGROUP;
+    }
+    return -1;
+}
+
+static long long measure_memory(int measure) {
+    return measure == PRECISE_CGROUP ? cgroup_memory_usage() : rss_bytes();
+}
+
+bool settle_memory(EatMemory* em, long long target, double tolerance, int measure) {
+    const char* name = measure == PRECISE_CGROUP ? "cgroup usage" : "RSS";
+    long page = sysconf(_SC_PAGE_SIZE);
+    long long slack = (long long)(target * tolerance);
+    long long current = measure_memory(measure);
+    if(current < 0) {
+        printf("ERROR: The %s of this process is not available\n", name);
+        return false;
+    }
+    for(int round = 0; round < SETTLE_ROUNDS; round++) {
+        long long error = current - target;
+        if(llabs(error) <= slack || llabs(error) < page) {
+            break;
+        }
+        if(error < 0) {
+            printf("%s %lld bytes short, growing\n", name, -error);
+            if(em_grow(em, -error) != 0) {
+                printf("ERROR: Could not allocate the memory\n");
+                break;
+            }
+        } else {
+            EatMemoryStats stats;
+            em_stats(em, &stats);
+            if(stats.size == 0) {
+                printf("%s %lld bytes over with nothing left to release\n", name, error);
+                break;
+            }
+            printf("%s %lld bytes over, shrinking\n", name, error);
+            em_shrink(em, error);
+        }
+        long long previous = current;
+        current = measure_memory(measure);
+        if(current == previous) {
+            printf("%s did not change, giving up\n", name);
+            break;
+        }
+    }
+    long long error = current - target;
+    printf("Settled %s at %lld bytes, %+lld bytes (%+.3f%%) from the target\n", name, current, error,
+           100.0 * error / target);
+    return true;
+}
@@ -0,0 +1,21 @@
+#ifndef precise_h
+#define precise_h
+
+#include "eatmemory.h"
+
+// Measures compared against the target by settle_memory().
+#define PRECISE_RSS 0
+#define PRECISE_CGROUP 1
+
+// Returns the PRECISE_* measure named [name] ("rss" or "cgroup"), or -1.
+int precise_measure(const char* name);
+
+// Grows or shrinks [em] until the resident set size of the process, or the
+// memory charged to its cgroup, is within [tolerance] (a fraction) of
+// [target] bytes, compensating for the chunk headers, the bookkeeping arrays
+// and the rest of the process. Prints every adjustment and the final error,
+// which can remain outside the tolerance if freed memory is not returned to
+// the system. Returns false if the measure is not available.
+bool settle_memory(EatMemory* em, long long target, double tolerance, int measure);
+
+#endif
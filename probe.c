@@ -0,0 +1,98 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "eat.h"
+#include "probe.h"
+#include "util.h"
+
+#define MIN_STEP (1024L * 1024)
+// Memory left untouched on top of what the kernel and the cgroup report as
+// available, so the probe backs off before the OOM killer gets involved.
+#define SAFETY_MARGIN (64L * 1024 * 1024)
+
+// Returns how many more bytes can be eaten according to MemAvailable and the
+// cgroup limit, or -1 if neither is known.
+static long long headroom() {
+    long long available = read_keyed_value("/proc/meminfo", "MemAvailable");
+    available = available >= 0 ? available * 1024 : -1;
+    long long limit = cgroup_memory_limit();
+    long long usage = cgroup_memory_usage();
+    if(limit >= 0 && usage >= 0 && (available < 0 || limit - usage < available)) {
+        available = limit - usage;
+    }
+    return available;
+}
+
+// Adds a [step] byte extent and returns true if it was mapped without going
+// over the headroom or stalling on memory for more than [psi_limit] percent
+// of the time. Otherwise the extent is removed again and [reason] is set.
+static bool try_step(Extents* extents, long step, double psi_limit, const char** reason) {
+    long long room = headroom();
+    if(room >= 0 && step > room - SAFETY_MARGIN) {
+        *reason = "headroom";
+        return false;
+    }
+    long long stall = memory_stall_us();
+    long long start = now_ns();
+    if(!extents_grow(extents, step)) {
+        *reason = "allocation";
+        return false;
+    }
+    long long elapsed_us = (now_ns() - start) / 1000;
+    long long stalled = memory_stall_us() - stall;
+    if(stall >= 0 && elapsed_us > 0 && 100.0 * stalled / elapsed_us > psi_limit) {
+        extents_shrink(extents);
+        *reason = "pressure";
+        return false;
+    }
+    return true;
+}
+
+int eat_probe(long limit, double psi_limit, double backoff, int hold_seconds) {
+    Extents extents;
+    extents_init(&extents);
+    long page = sysconf(_SC_PAGE_SIZE);
+    long step = limit / 2 / page * page;
+    if(step < MIN_STEP) {
+        step = MIN_STEP;
+    }
+
+    long long start = now_ns();
+    printf("%8s  %12s  %12s  %s\n", "TIME_S", "STEP_KB", "TOTAL_KB", "RESULT");
+    while(step >= MIN_STEP && extents.total < limit) {
+        if(step > limit - extents.total) {
+            step = (limit - extents.total) / page * page;
+            if(step < MIN_STEP) {
+                break;
+            }
+        }
+        const char* reason = "ok";
+        bool ok = try_step(&extents, step, psi_limit, &reason);
+        printf("%8.2f  %12ld  %12ld  %s\n", (now_ns() - start) / 1e9, step / 1024, extents.total / 1024, reason);
+        fflush(stdout);
+        if(!ok) {
+            step = step / 2 / page * page;
+        }
+    }
+    long long reached_ns = now_ns() - start;
+    long peak = extents.total;
+
+    long target = (long)(peak * (1 - backoff / 100));
+    extents_truncate(&extents, target);
+
+    long long stall = memory_stall_us();
+    sleep(hold_seconds);
+    long long stalled = memory_stall_us() - stall;
+
+    printf("\nPeak %ld bytes reached in %.2f s\n", peak, reached_ns / 1e9);
+    printf("Reliably held %ld bytes (%.0f%% back-off)", extents.total, backoff);
+    if(stall >= 0) {
+        printf(", %.1f%% memory stall over %d s", hold_seconds > 0 ? stalled / 1e4 / hold_seconds : 0.0, hold_seconds);
+    }
+    printf("\n");
+    extents_free(&extents);
+    return 0;
+}
@@ -0,0 +1,13 @@
+#ifndef probe_h
+#define probe_h
+
+// Finds how much memory can reliably be held, up to [limit] bytes. Memory is
+// added in steps that halve every time a step fails to map, would not fit in
+// the available memory or the cgroup limit, or makes memory pressure stall
+// tasks for more than [psi_limit] percent of the step's duration. The result
+// is backed off by [backoff] percent, held for [hold_seconds] to check it is
+// stable, and reported along with the time it took to reach. Returns the
+// process exit code.
+int eat_probe(long limit, double psi_limit, double backoff, int hold_seconds);
+
+#endif
@@ -0,0 +1,287 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+#include "eat.h"
+#include "procs.h"
+#include "util.h"
+
+#define POLL_INTERVAL_MS 50
+// How long after the oom_kill counter goes up a SIGKILL is still put down to
+// the OOM killer.
+#define OOM_WINDOW_NS 1000000000LL
+
+#define MSG_ADJ_FAILED 'A'
+#define MSG_FILLED 'F'
+#define MSG_ALLOC_FAILED 'E'
+
+typedef struct {
+    pid_t pid;
+    int adj;
+    int fd;
+    bool alive;
+} Worker;
+
+typedef struct {
+    long long time_ms;
+    int worker;
+    pid_t pid;
+    int adj;
+    char event[48];
+} TimelineEntry;
+
+// Increases of the oom_kill counter not matched to a worker yet. Kills are
+// only matched within OOM_WINDOW_NS of the increase, so a SIGKILL sent by
+// someone else long after an unrelated OOM kill is not counted.
+typedef struct {
+    long long last;
+    long long unattributed;
+    long long increased_ns;
+} OomCounter;
+
+typedef struct {
+    TimelineEntry* entries;
+    int count;
+    int capacity;
+    long long start_ns;
+} Timeline;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void request_stop(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static void timeline_add(Timeline* timeline, int worker, const Worker* w, const char* event) {
+    if(timeline->count == timeline->capacity) {
+        int capacity = timeline->capacity < 16 ? 16 : timeline->capacity * 2;
+        TimelineEntry* entries = realloc(timeline->entries, sizeof(TimelineEntry) * capacity);
+        if(entries == NULL) {
+            return;
+        }
+        timeline->entries = entries;
+        timeline->capacity = capacity;
+    }
+    TimelineEntry* entry = &timeline->entries[timeline->count++];
+    entry->time_ms = (now_ns() - timeline->start_ns) / 1000000;
+    entry->worker = worker;
+    entry->pid = w ? w->pid : 0;
+    entry->adj = w ? w->adj : 0;
+    snprintf(entry->event, sizeof(entry->event), "%s", event);
+}
+
+static void worker_main(long share, int chunk, int adj, int fd) {
+    char msg;
+#ifdef __linux__
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+    FILE* f = fopen("/proc/self/oom_score_adj", "w");
+    if(f == NULL || fprintf(f, "%d", adj) < 0 || fclose(f) != 0) {
+        msg = MSG_ADJ_FAILED;
+        if(write(fd, &msg, 1) < 0) {
+            _exit(1);
+        }
+    }
+    short** eaten = eat(share, chunk);
+    msg = eaten ? MSG_FILLED : MSG_ALLOC_FAILED;
+    if(write(fd, &msg, 1) < 0 || eaten == NULL) {
+        _exit(2);
+    }
+    while(true) {
+        pause();
+    }
+}
+
+// Reads the oom_kill counter and returns how much it went up since the last
+// call.
+static long long oom_poll(OomCounter* oom) {
+    long long ooms = oom_kill_count();
+    if(ooms <= oom->last) {
+        return 0;
+    }
+    long long increase = ooms - oom->last;
+    oom->unattributed += increase;
+    oom->increased_ns = now_ns();
+    oom->last = ooms;
+    return increase;
+}
+
+static void reap(Timeline* timeline, Worker* workers, int i, OomCounter* oom) {
+    int status;
+    Worker* w = &workers[i];
+    while(waitpid(w->pid, &status, 0) < 0 && errno == EINTR);
+    close(w->fd);
+    w->alive = false;
+
+    oom_poll(oom);
+    if(now_ns() - oom->increased_ns > OOM_WINDOW_NS) {
+        oom->unattributed = 0;
+    }
+
+    char event[48];
+    if(WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL && oom->unattributed > 0) {
+        oom->unattributed--;
+        snprintf(event, sizeof(event), "oom-killed (estimated)");
+    } else if(WIFSIGNALED(status)) {
+        snprintf(event, sizeof(event), "killed by signal %d", WTERMSIG(status));
+    } else {
+        snprintf(event, sizeof(event), "exited with status %d", WEXITSTATUS(status));
+    }
+    timeline_add(timeline, i, w, event);
+}
+
+static void print_timeline(const Timeline* timeline, FILE* out, bool csv) {
+    if(csv) {
+        fprintf(out, "time_ms,worker,pid,oom_score_adj,event\n");
+    } else {
+        fprintf(out, "%10s  %6s  %8s  %6s  %s\n", "TIME_MS", "WORKER", "PID", "ADJ", "EVENT");
+    }
+    for(int i = 0; i < timeline->count; i++) {
+        const TimelineEntry* e = &timeline->entries[i];
+        if(csv && e->worker < 0) {
+            fprintf(out, "%lld,,,,%s\n", e->time_ms, e->event);
+        } else if(csv) {
+            fprintf(out, "%lld,%d,%d,%d,%s\n", e->time_ms, e->worker, (int)e->pid, e->adj, e->event);
+        } else if(e->worker < 0) {
+            fprintf(out, "%10lld  %6s  %8s  %6s  %s\n", e->time_ms, "-", "-", "-", e->event);
+        } else {
+            fprintf(out, "%10lld  %6d  %8d  %6d  %s\n", e->time_ms, e->worker, (int)e->pid, e->adj, e->event);
+        }
+    }
+}
+
+int eat_procs(long total, int chunk, int procs, const int* adjs, int adj_count, int timeout, const char* timeline_path) {
+    Worker* workers = calloc(procs, sizeof(Worker));
+    struct pollfd* fds = calloc(procs, sizeof(struct pollfd));
+    int* fd_worker = calloc(procs, sizeof(int));
+    if(workers == NULL || fds == NULL || fd_worker == NULL) {
+        printf("ERROR: Could not allocate the workers\n");
+        return 1;
+    }
+
+    Timeline timeline = {NULL, 0, 0, now_ns()};
+    OomCounter oom = {oom_kill_count(), 0, 0};
+    long share = total / procs;
+
+    fflush(stdout);
+    for(int i = 0; i < procs; i++) {
+        int pipefd[2];
+        if(pipe(pipefd) != 0) {
+            perror("pipe");
+            return 1;
+        }
+        workers[i].adj = adj_count > 0 ? adjs[i < adj_count ? i : adj_count - 1] : 0;
+        long worker_share = i == procs - 1 ? total - share * (procs - 1) : share;
+        pid_t pid = fork();
+        if(pid < 0) {
+            perror("fork");
+            return 1;
+        }
+        if(pid == 0) {
+            close(pipefd[0]);
+            worker_main(worker_share, chunk, workers[i].adj, pipefd[1]);
+        }
+        close(pipefd[1]);
+        workers[i].pid = pid;
+        workers[i].fd = pipefd[0];
+        workers[i].alive = true;
+        timeline_add(&timeline, i, &workers[i], "started");
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = request_stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    if(timeout >= 0) {
+        printf("Workers started, stopping them after %d seconds...\n", timeout);
+    } else {
+        printf("Workers started, interrupt this process to stop them\n");
+    }
+
+    long long deadline = timeout >= 0 ? timeline.start_ns + timeout * 1000000000LL : -1;
+    int alive = procs;
+    while(alive > 0 && !stop_requested && (deadline < 0 || now_ns() < deadline)) {
+        int nfds = 0;
+        for(int i = 0; i < procs; i++) {
+            if(workers[i].alive) {
+                fds[nfds].fd = workers[i].fd;
+                fds[nfds].events = POLLIN;
+                fd_worker[nfds++] = i;
+            }
+        }
+        int ready = poll(fds, nfds, POLL_INTERVAL_MS);
+
+        long long increase = oom_poll(&oom);
+        if(increase > 0) {
+            char event[48];
+            snprintf(event, sizeof(event), "oom_kill counter +%lld", increase);
+            timeline_add(&timeline, -1, NULL, event);
+        }
+
+        for(int j = 0; ready > 0 && j < nfds; j++) {
+            if(fds[j].revents == 0) {
+                continue;
+            }
+            int i = fd_worker[j];
+            char msg;
+            if(read(workers[i].fd, &msg, 1) == 1) {
+                timeline_add(&timeline, i, &workers[i],
+                    msg == MSG_FILLED ? "filled" : msg == MSG_ADJ_FAILED ? "could not set oom_score_adj" : "allocation failed");
+            } else {
+                reap(&timeline, workers, i, &oom);
+                alive--;
+            }
+        }
+    }
+
+    for(int i = 0; i < procs; i++) {
+        if(workers[i].alive) {
+            kill(workers[i].pid, SIGTERM);
+            reap(&timeline, workers, i, &oom);
+        }
+    }
+
+    printf("\n");
+    print_timeline(&timeline, stdout, false);
+
+    // The counter does not say which process was killed, so a worker SIGKILLed
+    // while it went up is only likely to be the victim.
+    printf("\nOOM kill order (estimated from the oom_kill counter):");
+    int killed = 0;
+    for(int i = 0; i < timeline.count; i++) {
+        if(strcmp(timeline.entries[i].event, "oom-killed (estimated)") == 0) {
+            printf("%s worker %d (adj %d)", killed++ ? "," : "", timeline.entries[i].worker, timeline.entries[i].adj);
+        }
+    }
+    printf("%s\n", killed ? "" : " none");
+
+    if(timeline_path != NULL) {
+        FILE* f = fopen(timeline_path, "w");
+        if(f == NULL) {
+            perror(timeline_path);
+        } else {
+            print_timeline(&timeline, f, true);
+            fclose(f);
+        }
+    }
+
+    free(timeline.entries);
+    free(fd_worker);
+    free(fds);
+    free(workers);
+    return 0;
+}
@@ -0,0 +1,13 @@
+#ifndef procs_h
+#define procs_h
+
+// Forks [procs] workers that each eat their share of [total] bytes with their
+// own oom_score_adj, taken from [adjs] in order (the last value is reused when
+// there are fewer values than workers). The supervisor records when workers
+// fill, exit or are estimated to be OOM-killed, and prints the timeline once every worker is
+// gone, [timeout] seconds have passed (if non-negative) or it is interrupted.
+// The timeline is also written as CSV to [timeline_path] if it is not NULL.
+// Returns the process exit code.
+int eat_procs(long total, int chunk, int procs, const int* adjs, int adj_count, int timeout, const char* timeline_path);
+
+#endif
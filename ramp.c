@@ -0,0 +1,83 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "eatmemory.h"
+#include "loop.h"
+#include "ramp.h"
+#include "util.h"
+
+typedef struct {
+    EatMemory* em;
+    long total;
+    long step;
+    int timeout;
+    long long start;
+    int step_id;
+    bool failed;
+} Ramp;
+
+static void on_deadline(Loop* loop, void* data) {
+    (void)data;
+    loop_stop(loop);
+}
+
+// Grows the memory by one step, or by all of them if there is no interval
+// between steps, and starts holding it once the total is reached.
+static void on_step(Loop* loop, void* data) {
+    Ramp* ramp = data;
+    EatMemoryStats stats;
+    em_stats(ramp->em, &stats);
+    do {
+        long long stall = memory_stall_us();
+        if(em_grow(ramp->em, ramp->step < ramp->total - stats.size ? ramp->step : ramp->total - stats.size) != 0) {
+            printf("ERROR: Could not allocate the memory");
+            ramp->failed = true;
+            loop_stop(loop);
+            return;
+        }
+        long long stalled = stall >= 0 ? memory_stall_us() - stall : -1;
+        em_stats(ramp->em, &stats);
+        printf("%8.2f  %12lld  %12lld  %10.1f\n", (now_ns() - ramp->start) / 1e9, stats.size / 1024,
+               stats.resident / 1024, stalled / 1e3);
+        fflush(stdout);
+    } while(ramp->step_id < 0 && stats.size < ramp->total);
+    if(stats.size < ramp->total) {
+        return;
+    }
+    loop_remove(loop, ramp->step_id);
+    printf("Ramped to %lld bytes in %.2f s\n", stats.size, (now_ns() - ramp->start) / 1e9);
+    if(ramp->timeout >= 0) {
+        printf("Done, holding for %d seconds before exiting...\n", ramp->timeout);
+        loop_add_timer(loop, ramp->timeout * 1000000000LL, 0, on_deadline, ramp);
+    } else {
+        printf("Done, interrupt this process to free the memory\n");
+    }
+    fflush(stdout);
+}
+
+int eat_ramp(long total, long step, int interval, int timeout) {
+    Loop* loop = loop_new();
+    if(loop == NULL) {
+        printf("ERROR: Could not set up the event loop\n");
+        return 1;
+    }
+    Ramp ramp = {em_new(0), total, step, timeout, now_ns(), -1, false};
+    if(ramp.em == NULL) {
+        printf("ERROR: Could not allocate the memory");
+        loop_free(loop);
+        return 1;
+    }
+    printf("%8s  %12s  %12s  %10s\n", "TIME_S", "TOTAL_KB", "RSS_KB", "STALL_MS");
+    if(interval > 0) {
+        ramp.step_id = loop_add_timer(loop, 0, interval * 1000000000LL, on_step, &ramp);
+    } else {
+        loop_add_timer(loop, 0, 0, on_step, &ramp);
+    }
+    loop_run(loop);
+    loop_free(loop);
+    em_free(ramp.em);
+    return ramp.failed ? 1 : 0;
+}
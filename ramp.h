@@ -0,0 +1,10 @@
+#ifndef ramp_h
+#define ramp_h
+
+// Eats [total] bytes gradually, [step] bytes every [interval] seconds, and
+// reports the resident set size and memory stall after each step. Once the
+// total is reached the memory is held for [timeout] seconds, or until
+// interrupted if negative. Returns the process exit code.
+int eat_ramp(long total, long step, int interval, int timeout);
+
+#endif
@@ -0,0 +1,68 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "region.h"
+
+bool region_map(Region* region, long size, bool thp) {
+    region->page_size = sysconf(_SC_PAGE_SIZE);
+    region->size = (size + region->page_size - 1) / region->page_size * region->page_size;
+    region->thp = thp;
+
+    // Over-map by the alignment and trim both ends.
+    long mapped = region->size + REGION_ALIGN;
+    char* raw = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(raw == MAP_FAILED) {
+        return false;
+    }
+    char* base = (char*)(((uintptr_t)raw + REGION_ALIGN - 1) & ~(uintptr_t)(REGION_ALIGN - 1));
+    if(base > raw) {
+        munmap(raw, base - raw);
+    }
+    if(base + region->size < raw + mapped) {
+        munmap(base + region->size, raw + mapped - (base + region->size));
+    }
+    region->base = base;
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+    madvise(base, region->size, thp ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+#endif
+    for(long i = 0; i < region->size; i += region->page_size) {
+        base[i] = 1;
+    }
+    return true;
+}
+
+long region_pages(const Region* region) {
+    return region->size / region->page_size;
+}
+
+long long region_thp_bytes(const Region* region) {
+    FILE* f = fopen("/proc/self/smaps", "r");
+    if(f == NULL) {
+        return -1;
+    }
+    uintptr_t base = (uintptr_t)region->base;
+    char line[256];
+    bool inside = false;
+    long long kb = -1;
+    while(fgets(line, sizeof(line), f)) {
+        unsigned long start, end;
+        // Mapping headers start with the address range, the fields of the
+        // mapping follow as "Name: value" lines.
+        if(sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+            inside = start >= base && start < base + region->size;
+        } else if(inside && strncmp(line, "AnonHugePages:", 14) == 0) {
+            kb = (kb < 0 ? 0 : kb) + strtoll(line + 14, NULL, 10);
+        }
+    }
+    fclose(f);
+    return kb < 0 ? -1 : kb * 1024;
+}
+
+void region_unmap(Region* region) {
+    munmap(region->base, region->size);
+}
@@ -0,0 +1,32 @@
+#ifndef region_h
+#define region_h
+
+#include <stdbool.h>
+
+// Alignment of regions, so they can be backed by 2 MiB transparent huge pages.
+#define REGION_ALIGN (2L * 1024 * 1024)
+
+// A contiguous, page-aligned region of anonymous memory.
+typedef struct {
+    char* base;
+    long size;
+    long page_size;
+    bool thp;
+} Region;
+
+// Maps [size] bytes (rounded up to whole pages) aligned to REGION_ALIGN,
+// asks for transparent huge pages if [thp] and for small pages otherwise,
+// and touches every page. Returns false if the mapping failed.
+bool region_map(Region* region, long size, bool thp);
+
+// Returns the number of base pages in the region.
+long region_pages(const Region* region);
+
+// Returns the bytes of the region backed by transparent huge pages, or -1 if
+// this is not known.
+long long region_thp_bytes(const Region* region);
+
+// Unmaps the region.
+void region_unmap(Region* region);
+
+#endif
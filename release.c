@@ -0,0 +1,127 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "release.h"
+#include "util.h"
+
+typedef struct {
+    Extents* extents;
+    short** eaten;
+    int method;
+    long from;
+    long to;
+} ReleaseRange;
+
+int release_method(const char* name) {
+    if(strcmp(name, "free") == 0) {
+        return RELEASE_FREE;
+    } else if(strcmp(name, "munmap") == 0) {
+        return RELEASE_MUNMAP;
+#ifdef MADV_DONTNEED
+    } else if(strcmp(name, "dontneed") == 0) {
+        return RELEASE_DONTNEED;
+#endif
+#ifdef MADV_FREE
+    } else if(strcmp(name, "madv-free") == 0) {
+        return RELEASE_MADV_FREE;
+#endif
+    }
+    return -1;
+}
+
+static void* release_range(void* arg) {
+    ReleaseRange* range = arg;
+    for(long i = range->from; i < range->to; i++) {
+        if(range->eaten) {
+            free(range->eaten[i]);
+            continue;
+        }
+        char* base = range->extents->bases[i];
+        long size = range->extents->sizes[i];
+        switch(range->method) {
+            case RELEASE_MUNMAP:
+                munmap(base, size);
+                break;
+#ifdef MADV_DONTNEED
+            case RELEASE_DONTNEED:
+                madvise(base, size, MADV_DONTNEED);
+                break;
+#endif
+#ifdef MADV_FREE
+            case RELEASE_MADV_FREE:
+                madvise(base, size, MADV_FREE);
+                break;
+#endif
+        }
+    }
+    return NULL;
+}
+
+// Splits [count] units into [threads] contiguous ranges and releases them in
+// parallel, running the first range on the calling thread.
+static long long release_parallel(ReleaseRange proto, long count, int threads) {
+    if(threads > count) {
+        threads = count > 0 ? count : 1;
+    }
+    pthread_t* ids = malloc(sizeof(pthread_t) * threads);
+    ReleaseRange* ranges = malloc(sizeof(ReleaseRange) * threads);
+    bool* started = calloc(threads, sizeof(bool));
+    long long start = now_ns();
+    if(ids == NULL || ranges == NULL || started == NULL) {
+        proto.from = 0;
+        proto.to = count;
+        release_range(&proto);
+    } else {
+        for(int t = 0; t < threads; t++) {
+            ranges[t] = proto;
+            ranges[t].from = count * t / threads;
+            ranges[t].to = count * (t + 1) / threads;
+        }
+        for(int t = 1; t < threads; t++) {
+            started[t] = pthread_create(&ids[t], NULL, release_range, &ranges[t]) == 0;
+        }
+        for(int t = 0; t < threads; t++) {
+            if(!started[t]) {
+                release_range(&ranges[t]);
+            }
+        }
+        for(int t = 1; t < threads; t++) {
+            if(started[t]) {
+                pthread_join(ids[t], NULL);
+            }
+        }
+    }
+    long long elapsed = now_ns() - start;
+    free(started);
+    free(ranges);
+    free(ids);
+    return elapsed;
+}
+
+long long release_extents(Extents* extents, int method, int threads) {
+    ReleaseRange proto = {extents, NULL, method, 0, 0};
+    long long elapsed = release_parallel(proto, extents->count, threads);
+    if(method != RELEASE_MUNMAP) {
+        // The advice only drops the pages; the mappings are gone from the
+        // extents either way, so they are unmapped too, outside the timing.
+        for(long i = 0; i < extents->count; i++) {
+            munmap(extents->bases[i], extents->sizes[i]);
+        }
+    }
+    free(extents->bases);
+    free(extents->sizes);
+    extents_init(extents);
+    return elapsed;
+}
+
+long long release_chunks(short** eaten, long total, int chunk, int threads) {
+    ReleaseRange proto = {NULL, eaten, RELEASE_FREE, 0, 0};
+    long long elapsed = release_parallel(proto, (total + chunk - 1) / chunk, threads);
+    free(eaten);
+    return elapsed;
+}
@@ -0,0 +1,25 @@
+#ifndef release_h
+#define release_h
+
+#include "eat.h"
+
+#define RELEASE_FREE 0
+#define RELEASE_MUNMAP 1
+#define RELEASE_DONTNEED 2
+#define RELEASE_MADV_FREE 3
+
+// Returns the release method called [name] ("free", "munmap", "dontneed" or
+// "madv-free"), or -1 if there is no such method or it is not supported on
+// this platform.
+int release_method(const char* name);
+
+// Releases [extents] with [method] (any method but RELEASE_FREE), splitting
+// them across [threads] threads, then unmaps them if [method] only advised
+// the kernel. Returns the elapsed time of the release itself in nanoseconds.
+long long release_extents(Extents* extents, int method, int threads);
+
+// Frees the blocks returned by eat(), splitting them across [threads]
+// threads. Returns the elapsed time in nanoseconds.
+long long release_chunks(short** eaten, long total, int chunk, int threads);
+
+#endif
@@ -0,0 +1,40 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <sys/mman.h>
+#include "reserve.h"
+#include "util.h"
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+char* reserve(long total, bool noreserve, double fraction) {
+    long long committed_before = read_keyed_value("/proc/meminfo", "Committed_AS");
+    long long anon_before = read_keyed_value("/proc/meminfo", "AnonPages");
+
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | (noreserve ? MAP_NORESERVE : 0);
+    long long start = now_ns();
+    char* base = mmap(NULL, total, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if(base == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+    long long mapped = now_ns();
+    long touched = fraction > 0 ? touch_fraction(base, total, fraction) : 0;
+    long long end = now_ns();
+
+    printf("Reserved in %.3f ms, touched %ld pages in %.1f ms\n", (mapped - start) / 1e6, touched, (end - mapped) / 1e6);
+    long long committed = read_keyed_value("/proc/meminfo", "Committed_AS");
+    long long limit = read_keyed_value("/proc/meminfo", "CommitLimit");
+    if(committed >= 0 && limit >= 0) {
+        printf("Committed_AS %lld kB (%+lld kB), CommitLimit %lld kB, headroom %lld kB, AnonPages %+lld kB\n",
+            committed, committed - committed_before, limit, limit - committed,
+            read_keyed_value("/proc/meminfo", "AnonPages") - anon_before);
+    }
+    return base;
+}
+
+void unreserve(char* base, long total) {
+    munmap(base, total);
+}
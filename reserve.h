@@ -0,0 +1,15 @@
+#ifndef reserve_h
+#define reserve_h
+
+#include <stdbool.h>
+
+// Maps [total] bytes of anonymous memory, with MAP_NORESERVE if [noreserve],
+// and writes to [touch_fraction] (0-1) of its pages, so it consumes commit
+// charge without consuming RAM. Reports the change in Committed_AS and the
+// CommitLimit. Returns NULL if the mapping failed.
+char* reserve(long total, bool noreserve, double touch_fraction);
+
+// Unmaps a region returned by reserve().
+void unreserve(char* base, long total);
+
+#endif
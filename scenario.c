@@ -0,0 +1,293 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "handle.h"
+#include "scenario.h"
+#include "util.h"
+#include "verify.h"
+
+#define LINE_MAX_LEN 512
+
+typedef enum { EAT, RAMP, TOUCH, HOLD, PAGEOUT, VERIFY, RELEASE } Mode;
+
+static const char* MODE_NAMES[] = { "eat", "ramp", "touch", "hold", "pageout", "verify", "release" };
+
+typedef struct {
+    Mode mode;
+    long line;
+    long long size;
+    int duration;
+    char method[16];
+    int threads;
+} Phase;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void request_stop(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+// Parses a size like em_parse_size(), with percentages of [available] bytes.
+static long long parse_size(const char* text, long long available) {
+    size_t len = strlen(text);
+    if(len > 1 && text[len - 1] == '%') {
+        return atoll(text) * available / 100;
+    }
+    return em_parse_size(text);
+}
+
+// Parses a duration in seconds, minutes ("5m") or hours ("1h"). Returns -1 if
+// it is not valid.
+static int parse_duration(const char* text) {
+    char* end;
+    long value = strtol(text, &end, 10);
+    int unit = strcmp(end, "m") == 0 ? 60 : strcmp(end, "h") == 0 ? 3600 : strcmp(end, "s") == 0 || *end == 0 ? 1 : 0;
+    return unit == 0 || end == text || value < 0 ? -1 : (int)(value * unit);
+}
+
+static bool parse_phase(Phase* phase, char* line, long long available, uint64_t* seed) {
+    char* token = strtok(line, " \t\r\n");
+    int mode = -1;
+    for(int i = 0; i < (int)(sizeof(MODE_NAMES) / sizeof(MODE_NAMES[0])); i++) {
+        if(strcmp(token, MODE_NAMES[i]) == 0) {
+            mode = i;
+        }
+    }
+    if(mode < 0) {
+        printf("ERROR: %ld: Unknown mode %s\n", phase->line, token);
+        return false;
+    }
+    phase->mode = mode;
+    phase->size = -1;
+    phase->duration = 0;
+    snprintf(phase->method, sizeof(phase->method), "munmap");
+    phase->threads = 1;
+    while((token = strtok(NULL, " \t\r\n")) != NULL) {
+        char* value = strchr(token, '=');
+        if(value == NULL) {
+            printf("ERROR: %ld: Expected key=value, got %s\n", phase->line, token);
+            return false;
+        }
+        *value++ = 0;
+        if(strcmp(token, "size") == 0) {
+            phase->size = parse_size(value, available);
+        } else if(strcmp(token, "duration") == 0) {
+            phase->duration = parse_duration(value);
+        } else if(strcmp(token, "method") == 0) {
+            snprintf(phase->method, sizeof(phase->method), "%s", value);
+        } else if(strcmp(token, "threads") == 0) {
+            phase->threads = atoi(value);
+        } else if(strcmp(token, "seed") == 0) {
+            *seed = strtoull(value, NULL, 10);
+        } else {
+            printf("ERROR: %ld: Unknown parameter %s\n", phase->line, token);
+            return false;
+        }
+    }
+    if(((mode == EAT || mode == RAMP) && phase->size < 0) || phase->duration < 0 || phase->threads < 1) {
+        printf("ERROR: %ld: Invalid size, duration or threads\n", phase->line);
+        return false;
+    }
+#ifndef MADV_PAGEOUT
+    if(mode == PAGEOUT) {
+        printf("ERROR: %ld: pageout is not supported on this platform\n", phase->line);
+        return false;
+    }
+#endif
+    return true;
+}
+
+// Parses the scenario at [path] into [phases]. Returns the number of phases,
+// or -1 if the file could not be read or has an error.
+static int parse_scenario(const char* path, Phase* phases, long long available, uint64_t* seed) {
+    FILE* f = fopen(path, "r");
+    if(f == NULL) {
+        printf("ERROR: Could not open %s\n", path);
+        return -1;
+    }
+    char line[LINE_MAX_LEN];
+    int count = 0;
+    for(long number = 1; fgets(line, sizeof(line), f) != NULL; number++) {
+        char* comment = strchr(line, '#');
+        if(comment != NULL) {
+            *comment = 0;
+        }
+        if(strspn(line, " \t\r\n") == strlen(line)) {
+            continue;
+        }
+        if(count == SCENARIO_MAX_PHASES) {
+            printf("ERROR: More than %d phases\n", SCENARIO_MAX_PHASES);
+            count = -1;
+            break;
+        }
+        phases[count].line = number;
+        if(!parse_phase(&phases[count], line, available, seed)) {
+            count = -1;
+            break;
+        }
+        count++;
+    }
+    fclose(f);
+    return count;
+}
+
+// Grows or shrinks [em] to [target] bytes, writing the verify pattern of
+// [seed] to the extents that were added if [patterned].
+static bool resize(EatMemory* em, long long target, bool patterned, uint64_t seed, long* filled) {
+    long long size = em->extents.total;
+    if(target > size && em_grow(em, target - size) != 0) {
+        return false;
+    } else if(target < size) {
+        em_shrink(em, size - target);
+    }
+    if(*filled > em->extents.count) {
+        *filled = em->extents.count;
+    }
+    for(; patterned && *filled < em->extents.count; (*filled)++) {
+        verify_fill(em->extents.bases[*filled], em->extents.sizes[*filled], seed);
+    }
+    return true;
+}
+
+// Runs [phase] and describes its outcome in [detail]. Returns false if the
+// scenario can't go on.
+static bool run_phase(EatMemory* em, Phase* phase, bool patterned, uint64_t seed, long* filled, char* detail, size_t len, int* status) {
+    long page = sysconf(_SC_PAGE_SIZE);
+    long long start = now_ns();
+    long long deadline = start + phase->duration * 1000000000LL;
+    detail[0] = 0;
+    switch(phase->mode) {
+    case EAT: {
+        long long changed = llabs(phase->size - em->extents.total);
+        if(!resize(em, phase->size, patterned, seed, filled)) {
+            snprintf(detail, len, "allocation failed");
+            return false;
+        }
+        snprintf(detail, len, "%.2f GB/s", (double)changed / (now_ns() - start));
+        break;
+    }
+    case RAMP: {
+        long long from = em->extents.total;
+        int steps = phase->duration > 0 ? phase->duration : 1;
+        for(int i = 1; i <= steps && !stop_requested; i++) {
+            if(!resize(em, from + (phase->size - from) * i / steps / page * page, patterned, seed, filled)) {
+                snprintf(detail, len, "allocation failed");
+                return false;
+            }
+            if(i < steps) {
+                sleep_ns(start + i * 1000000000LL - now_ns(), &stop_requested);
+            }
+        }
+        if(!resize(em, phase->size, patterned, seed, filled)) {
+            snprintf(detail, len, "allocation failed");
+            return false;
+        }
+        snprintf(detail, len, "%d steps", steps);
+        break;
+    }
+    case TOUCH: {
+        long passes = 0;
+        do {
+            em_touch(em);
+            passes++;
+        } while(!stop_requested && now_ns() < deadline);
+        snprintf(detail, len, "%ld passes, %.2f pages/us", passes,
+                 (double)passes * (em->extents.total / page) / ((now_ns() - start) / 1e3));
+        break;
+    }
+    case HOLD:
+        sleep_ns(deadline - now_ns(), &stop_requested);
+        break;
+    case PAGEOUT: {
+#ifdef MADV_PAGEOUT
+        long long rss = rss_bytes();
+        for(long i = 0; i < em->extents.count; i++) {
+            madvise(em->extents.bases[i], em->extents.sizes[i], MADV_PAGEOUT);
+        }
+        snprintf(detail, len, "RSS %+lld kB", (rss_bytes() - rss) / 1024);
+#endif
+        break;
+    }
+    case VERIFY: {
+        VerifyResult result = {0, 0, {NULL}};
+        for(long i = 0; i < em->extents.count; i++) {
+            verify_pages(&result, em->extents.bases[i], em->extents.sizes[i], seed);
+        }
+        snprintf(detail, len, "%ld of %ld pages mismatched", result.mismatched, result.pages);
+        if(result.mismatched > 0) {
+            *status = 2;
+        }
+        break;
+    }
+    case RELEASE: {
+        long long elapsed = em_release(em, phase->method, phase->threads);
+        if(elapsed < 0) {
+            snprintf(detail, len, "invalid method %s", phase->method);
+            return false;
+        }
+        *filled = 0;
+        snprintf(detail, len, "%s, %d threads", phase->method, phase->threads);
+        break;
+    }
+    }
+    return true;
+}
+
+int run_scenario(const char* path, Victim* victim) {
+    Phase phases[SCENARIO_MAX_PHASES];
+    uint64_t seed = 1;
+    int count = parse_scenario(path, phases, em_free_system_memory(), &seed);
+    if(count < 0) {
+        return 1;
+    }
+    bool patterned = false;
+    for(int i = 0; i < count; i++) {
+        patterned = patterned || phases[i].mode == VERIFY;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = request_stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    EatMemory* em = em_new(0);
+    if(em == NULL) {
+        printf("ERROR: Could not allocate the memory");
+        return 1;
+    }
+    int status = 0;
+    long filled = 0;
+    long long start = now_ns();
+    printf("Running %d phases from %s...\n", count, path);
+    printf("%5s  %-8s  %8s  %12s  %12s  %10s  %s\n", "PHASE", "MODE", "TIME_S", "SIZE_KB", "RSS_KB", "STALL_MS", "DETAIL");
+    for(int i = 0; i < count && !stop_requested; i++) {
+        char detail[96];
+        char name[32];
+        snprintf(name, sizeof(name), "%d %s", i + 1, MODE_NAMES[phases[i].mode]);
+        victim_phase(victim, name);
+        long long stall = memory_stall_us();
+        long long phase_start = now_ns();
+        bool ok = run_phase(em, &phases[i], patterned, seed, &filled, detail, sizeof(detail), &status);
+        long long stalled = stall >= 0 ? memory_stall_us() - stall : -1;
+        printf("%5d  %-8s  %8.2f  %12ld  %12lld  %10.1f  %s\n", i + 1, MODE_NAMES[phases[i].mode],
+               (now_ns() - phase_start) / 1e9, em->extents.total / 1024, rss_bytes() / 1024, stalled / 1e3, detail);
+        fflush(stdout);
+        if(!ok) {
+            printf("ERROR: Phase %d (line %ld) failed\n", i + 1, phases[i].line);
+            status = 1;
+            break;
+        }
+    }
+    em_free(em);
+    printf("%s in %.2f s\n", stop_requested ? "Interrupted" : "Scenario completed", (now_ns() - start) / 1e9);
+    victim_finish(victim);
+    return status;
+}
@@ -0,0 +1,28 @@
+#ifndef scenario_h
+#define scenario_h
+
+#include "victim.h"
+
+// Maximum number of phases in a scenario file.
+#define SCENARIO_MAX_PHASES 64
+
+// Runs the phases listed in the scenario file at [path] one after the other
+// on the same eaten memory, and reports each phase as it completes. Each
+// line names a mode followed by key=value parameters, e.g.
+//
+//   eat size=60%
+//   touch duration=5m
+//   ramp size=90% duration=60
+//   pageout
+//   verify
+//   release method=munmap threads=4
+//
+// Percentages are of the memory available when the scenario starts. A seed=
+// parameter sets the seed of the verify pattern for the whole scenario, as
+// the pattern written by one phase is checked by later ones; the last one
+// given wins. If
+// [victim] is not NULL each phase is also a phase of the victim. Returns the
+// process exit code.
+int run_scenario(const char* path, Victim* victim);
+
+#endif
@@ -0,0 +1,106 @@
+#define _GNU_SOURCE
+
+#include "shmem.h"
+
+#ifdef SHMEM_BACKING
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "util.h"
+
+bool shmem_eat(Shmem* shm, long total, int flags) {
+    unsigned int mfd_flags = MFD_CLOEXEC;
+    if(flags & SHMEM_SEAL) {
+        mfd_flags |= MFD_ALLOW_SEALING;
+    }
+    if(flags & SHMEM_HUGETLB) {
+        mfd_flags |= MFD_HUGETLB;
+    }
+
+    long long shmem_before = read_keyed_value("/proc/meminfo", "Shmem");
+    long long huge_before = read_keyed_value("/proc/meminfo", "HugePages_Free");
+
+    shm->fd = memfd_create("eatmemory", mfd_flags);
+    if(shm->fd < 0) {
+        perror("memfd_create");
+        return false;
+    }
+    if(ftruncate(shm->fd, total) != 0) {
+        perror("ftruncate");
+        close(shm->fd);
+        return false;
+    }
+    if((flags & SHMEM_SEAL) && fcntl(shm->fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+        perror("F_ADD_SEALS");
+    }
+    shm->base = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, shm->fd, 0);
+    if(shm->base == MAP_FAILED) {
+        perror("mmap");
+        close(shm->fd);
+        return false;
+    }
+    shm->size = total;
+    // Fault the pages in through fallocate first where possible, so running
+    // out of tmpfs space fails cleanly instead of raising SIGBUS in memset.
+    if(!(flags & SHMEM_HUGETLB) && fallocate(shm->fd, 0, 0, total) != 0) {
+        perror("fallocate");
+        shmem_digest(shm);
+        return false;
+    }
+    memset(shm->base, 0, total);
+
+    long long shmem_after = read_keyed_value("/proc/meminfo", "Shmem");
+    printf("memfd %d (/proc/%d/fd/%d), Shmem %+lld kB",
+        shm->fd, (int)getpid(), shm->fd, shmem_after - shmem_before);
+    if(flags & SHMEM_HUGETLB) {
+        printf(", HugePages_Free %+lld", read_keyed_value("/proc/meminfo", "HugePages_Free") - huge_before);
+    }
+    printf("\n");
+    return true;
+}
+
+bool shmem_exec(Shmem* shm, const char* command) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if(pid < 0) {
+        perror("fork");
+        return false;
+    }
+    if(pid == 0) {
+        char fd[16];
+        snprintf(fd, sizeof(fd), "%d", shm->fd);
+        fcntl(shm->fd, F_SETFD, 0);
+        setenv("EATMEMORY_SHMEM_FD", fd, 1);
+        execl("/bin/sh", "sh", "-c", command, (char*)NULL);
+        perror("execl");
+        _exit(127);
+    }
+    printf("Started '%s' (pid %d) with EATMEMORY_SHMEM_FD=%d\n", command, (int)pid, shm->fd);
+    fflush(stdout);
+    int status;
+    while(waitpid(pid, &status, 0) < 0) {
+        if(errno != EINTR) {
+            perror("waitpid");
+            return false;
+        }
+    }
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("ERROR: '%s' failed with status %d\n", command, WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+        return false;
+    }
+    printf("'%s' exited\n", command);
+    return true;
+}
+
+void shmem_digest(Shmem* shm) {
+    munmap(shm->base, shm->size);
+    close(shm->fd);
+}
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef shmem_h
+#define shmem_h
+
+#include <stdbool.h>
+
+#ifdef __linux__
+#define SHMEM_BACKING
+#endif
+
+#ifdef SHMEM_BACKING
+
+#define SHMEM_HUGETLB 1
+#define SHMEM_SEAL 2
+
+// A region of shared memory backed by a memfd.
+typedef struct {
+    int fd;
+    char* base;
+    long size;
+} Shmem;
+
+// Creates a [total] byte memfd, maps it and touches every byte. [flags] is a
+// mask of SHMEM_HUGETLB (back it with hugetlbfs pages) and SHMEM_SEAL (seal
+// its size). Returns false if the memory could not be allocated.
+bool shmem_eat(Shmem* shm, long total, int flags);
+
+// Runs [command] through /bin/sh with the memfd inherited and its number in
+// the EATMEMORY_SHMEM_FD environment variable, and waits for it to exit while
+// the memory stays mapped. Returns false if it could not be started or did
+// not exit successfully.
+bool shmem_exec(Shmem* shm, const char* command);
+
+// Unmaps and closes the region.
+void shmem_digest(Shmem* shm);
+
+#endif
+
+#endif
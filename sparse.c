@@ -0,0 +1,55 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <sys/mman.h>
+#include "sparse.h"
+#include "util.h"
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+char* sparse(long total, long stride, bool write) {
+    long long tables_before = read_keyed_value("/proc/meminfo", "PageTables");
+    long long anon_before = read_keyed_value("/proc/meminfo", "AnonPages");
+
+    char* base = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(base == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+#ifdef MADV_NOHUGEPAGE
+    // A huge page would fill the whole stride instead of one page table entry.
+    madvise(base, total, MADV_NOHUGEPAGE);
+#endif
+    long long start = now_ns();
+    long touched = 0;
+    volatile char* pages = base;
+    char sink = 0;
+    for(long offset = 0; offset < total; offset += stride) {
+        if(write) {
+            pages[offset] = 1;
+        } else {
+            sink += pages[offset];
+        }
+        touched++;
+    }
+    (void)sink;
+    long long elapsed = now_ns() - start;
+
+    printf("Touched %ld pages in %.1f ms, %.0f pages/s, %.0f ns per page\n", touched, elapsed / 1e6,
+        touched / (elapsed / 1e9), (double)elapsed / touched);
+    long long tables = read_keyed_value("/proc/meminfo", "PageTables");
+    long long anon = read_keyed_value("/proc/meminfo", "AnonPages");
+    if(tables >= 0 && anon >= 0) {
+        long long grown = (tables - tables_before) + (anon - anon_before);
+        printf("PageTables %lld kB (%+lld kB), AnonPages %+lld kB, page tables are %.1f%% of the growth\n",
+            tables, tables - tables_before, anon - anon_before,
+            grown > 0 ? 100.0 * (tables - tables_before) / grown : 0.0);
+    }
+    return base;
+}
+
+void unsparse(char* base, long total) {
+    munmap(base, total);
+}
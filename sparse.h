@@ -0,0 +1,17 @@
+#ifndef sparse_h
+#define sparse_h
+
+#include <stdbool.h>
+
+// Maps [total] bytes of address space with MAP_NORESERVE and transparent huge
+// pages disabled, and touches one page every [stride] bytes. Read touches map
+// the shared zero page, so the memory consumed is almost only page tables;
+// with [write] every touched page also takes a page of RAM. Reports the
+// growth of PageTables and AnonPages and the touch rate. Returns NULL if the
+// mapping failed.
+char* sparse(long total, long stride, bool write);
+
+// Unmaps a region returned by sparse().
+void unsparse(char* base, long total);
+
+#endif
@@ -0,0 +1,121 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include "perf.h"
+#include "region.h"
+#include "tlb.h"
+#include "util.h"
+
+#define LINE 64
+#define MIN_ACCESSES (16L * 1024 * 1024)
+
+// Returns the offset of the cache line touched in [page].
+static long line_offset(long page, long page_size) {
+    unsigned long long h = page * 0x9e3779b97f4a7c15ULL;
+    return (long)((h >> 32) % (page_size / LINE)) * LINE;
+}
+
+// Links one cache line of every page into a single random cycle and returns
+// its first element.
+static char** build_chain(Region* region) {
+    long pages = region_pages(region);
+    long* order = malloc(sizeof(long) * pages);
+    if(order == NULL) {
+        return NULL;
+    }
+    unsigned long long rng = 0x2545f4914f6cdd1dULL;
+    for(long i = 0; i < pages; i++) {
+        order[i] = i;
+    }
+    for(long i = pages - 1; i > 0; i--) {
+        long j = xorshift(&rng) % (i + 1);
+        long t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    for(long i = 0; i < pages; i++) {
+        long from = order[i], to = order[(i + 1) % pages];
+        char** slot = (char**)(region->base + from * region->page_size + line_offset(from, region->page_size));
+        *slot = region->base + to * region->page_size + line_offset(to, region->page_size);
+    }
+    char** first = (char**)(region->base + order[0] * region->page_size + line_offset(order[0], region->page_size));
+    free(order);
+    return first;
+}
+
+// Chases the pointers once with small or huge pages, adding the DTLB misses
+// per access to the row if [dtlb].
+static int run_tlb(long total, bool thp, bool dtlb) {
+    Region region;
+    if(!region_map(&region, total, thp)) {
+        printf("ERROR: Could not allocate the memory\n");
+        return 1;
+    }
+    char** p = build_chain(&region);
+    if(p == NULL) {
+        printf("ERROR: Could not allocate the page order\n");
+        region_unmap(&region);
+        return 1;
+    }
+    long pages = region_pages(&region);
+    long accesses = pages * 4 > MIN_ACCESSES ? pages * 4 : MIN_ACCESSES;
+
+    // One untimed lap to fault in page tables and warm up.
+    for(long i = 0; i < pages; i++) {
+        p = (char**)*p;
+    }
+#ifdef PERF_COUNTERS
+    int fd = dtlb ? perf_open_dtlb_misses() : -1;
+    long long misses = perf_read(fd);
+#else
+    (void)dtlb;
+#endif
+    long long start = now_ns();
+    for(long i = 0; i < accesses; i++) {
+        p = (char**)*p;
+    }
+    long long elapsed = now_ns() - start;
+    // Keep the chase from being optimized away.
+    char** volatile sink = p;
+    (void)sink;
+
+    long long thp_bytes = region_thp_bytes(&region);
+    printf("%-6s  %10ld  %8.1f%%  %10.2f", thp ? "THP" : "4 KiB", pages,
+        thp_bytes >= 0 ? 100.0 * thp_bytes / region.size : 0, (double)elapsed / accesses);
+#ifdef PERF_COUNTERS
+    long long after = perf_read(fd);
+    perf_close(fd);
+    if(dtlb && misses >= 0 && after >= 0) {
+        printf("  %12.3f", (double)(after - misses) / accesses);
+    } else if(dtlb) {
+        printf("  %12s", "n/a");
+    }
+#endif
+    printf("\n");
+    region_unmap(&region);
+    return 0;
+}
+
+int eat_tlb(long total) {
+    bool dtlb = false;
+#ifdef PERF_COUNTERS
+    int fd = perf_open_dtlb_misses();
+    dtlb = fd >= 0;
+    perf_close(fd);
+#endif
+    printf("%-6s  %10s  %9s  %10s", "PAGES", "COUNT", "THP", "NS/ACCESS");
+    if(dtlb) {
+        printf("  %12s", "DTLB_MISS/ACC");
+    }
+    printf("\n");
+    int status = run_tlb(total, false, dtlb);
+#ifdef MADV_HUGEPAGE
+    if(status == 0) {
+        status = run_tlb(total, true, dtlb);
+    }
+#endif
+    return status;
+}
@@ -0,0 +1,11 @@
+#ifndef tlb_h
+#define tlb_h
+
+// Maps a [total] byte region and chases pointers through it touching exactly
+// one cache line per page, visiting the pages in a random order. Reports the
+// ns per access and the data TLB misses per access where perf counters are
+// available, once with small pages and once with transparent huge pages.
+// Returns the process exit code.
+int eat_tlb(long total);
+
+#endif
@@ -0,0 +1,188 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include "util.h"
+
+long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void sleep_ns(long long ns, volatile sig_atomic_t* stop) {
+    struct timespec ts = {ns / 1000000000LL, ns % 1000000000LL};
+    while(!*stop && nanosleep(&ts, &ts) != 0 && errno == EINTR);
+}
+
+unsigned long long xorshift(unsigned long long* state) {
+    unsigned long long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+long touch_fraction(char* base, long total, double fraction) {
+    long page = sysconf(_SC_PAGE_SIZE);
+    long pages = total / page;
+    long touched = 0;
+    for(long i = 0; i < pages; i++) {
+        if((long)((i + 1) * fraction) > (long)(i * fraction)) {
+            base[i * page]++;
+            touched++;
+        }
+    }
+    return touched;
+}
+
+long long read_keyed_value(const char* path, const char* key) {
+    FILE* f = fopen(path, "r");
+    if(f == NULL) {
+        return -1;
+    }
+    size_t key_len = strlen(key);
+    long long value = -1;
+    char line[256];
+    while(fgets(line, sizeof(line), f)) {
+        if(strncmp(line, key, key_len) == 0 && (line[key_len] == ':' || line[key_len] == ' ' || line[key_len] == '\t')) {
+            value = strtoll(line + key_len + 1, NULL, 10);
+            break;
+        }
+    }
+    fclose(f);
+    return value;
+}
+
+long long read_value(const char* path) {
+    FILE* f = fopen(path, "r");
+    if(f == NULL) {
+        return -1;
+    }
+    long long value;
+    int found = fscanf(f, "%lld", &value);
+    fclose(f);
+    return found == 1 ? value : -1;
+}
+
+long long rss_bytes() {
+    FILE* f = fopen("/proc/self/statm", "r");
+    if(f == NULL) {
+        return -1;
+    }
+    long long size, resident;
+    int found = fscanf(f, "%lld %lld", &size, &resident);
+    fclose(f);
+    return found == 2 ? resident * sysconf(_SC_PAGE_SIZE) : -1;
+}
+
+static bool cgroup_path(const char* controller, char* out, size_t len) {
+    FILE* f = fopen("/proc/self/cgroup", "r");
+    if(f == NULL) {
+        return false;
+    }
+    bool found = false;
+    char line[512];
+    while(!found && fgets(line, sizeof(line), f)) {
+        char* controllers = strchr(line, ':');
+        char* path = controllers ? strchr(controllers + 1, ':') : NULL;
+        if(path == NULL) {
+            continue;
+        }
+        *path++ = 0;
+        controllers++;
+        path[strcspn(path, "\n")] = 0;
+        if(controller == NULL ? *controllers == 0 : strstr(controllers, controller) != NULL) {
+            snprintf(out, len, "%s", strcmp(path, "/") == 0 ? "" : path);
+            found = true;
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+static bool first_existing(char* path, size_t len, const char* root, const char* group, const char* name) {
+    // Inside a cgroup namespace the group's directory is usually mounted as
+    // the root of the hierarchy, so try both locations.
+    snprintf(path, len, "%s%s/%s", root, group, name);
+    if(access(path, R_OK) == 0) {
+        return true;
+    }
+    snprintf(path, len, "%s/%s", root, name);
+    return access(path, R_OK) == 0;
+}
+
+bool cgroup_memory_file(const char* v2_name, const char* v1_name, char* path, size_t len) {
+    char group[256];
+    if(v2_name != NULL && cgroup_path(NULL, group, sizeof(group))) {
+        if(first_existing(path, len, "/sys/fs/cgroup", group, v2_name) ||
+           first_existing(path, len, "/sys/fs/cgroup/unified", group, v2_name)) {
+            return true;
+        }
+    }
+    if(v1_name != NULL && cgroup_path("memory", group, sizeof(group))) {
+        if(first_existing(path, len, "/sys/fs/cgroup/memory", group, v1_name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+long long oom_kill_count() {
+    char path[512];
+    long long count = -1;
+    if(cgroup_memory_file("memory.events", NULL, path, sizeof(path))) {
+        count = read_keyed_value(path, "oom_kill");
+    }
+    if(count < 0 && cgroup_memory_file(NULL, "memory.oom_control", path, sizeof(path))) {
+        count = read_keyed_value(path, "oom_kill");
+    }
+    if(count < 0) {
+        count = read_keyed_value("/proc/vmstat", "oom_kill");
+    }
+    return count;
+}
+
+long long cgroup_memory_limit() {
+    char path[512];
+    if(!cgroup_memory_file("memory.max", "memory.limit_in_bytes", path, sizeof(path))) {
+        return -1;
+    }
+    long long limit = read_value(path);
+    // cgroup v1 reports "no limit" as a huge page-aligned number.
+    return limit >= (1LL << 60) ? -1 : limit;
+}
+
+long long cgroup_memory_usage() {
+    char path[512];
+    if(!cgroup_memory_file("memory.current", "memory.usage_in_bytes", path, sizeof(path))) {
+        return -1;
+    }
+    return read_value(path);
+}
+
+long long memory_stall_us() {
+    char path[512];
+    if(!cgroup_memory_file("memory.pressure", NULL, path, sizeof(path))) {
+        snprintf(path, sizeof(path), "/proc/pressure/memory");
+    }
+    FILE* f = fopen(path, "r");
+    if(f == NULL) {
+        return -1;
+    }
+    long long total = -1;
+    char line[256];
+    while(fgets(line, sizeof(line), f)) {
+        char* field = strstr(line, "total=");
+        if(strncmp(line, "some", 4) == 0 && field != NULL) {
+            total = strtoll(field + 6, NULL, 10);
+            break;
+        }
+    }
+    fclose(f);
+    return total;
+}
@@ -0,0 +1,59 @@
+#ifndef util_h
+#define util_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <signal.h>
+
+// Returns a monotonic timestamp in nanoseconds.
+long long now_ns();
+
+// Sleeps for [ns] nanoseconds, returning early once [stop] is set by a signal
+// handler.
+void sleep_ns(long long ns, volatile sig_atomic_t* stop);
+
+// Advances a xorshift64 generator and returns the next value. [state] must not
+// be zero.
+unsigned long long xorshift(unsigned long long* state);
+
+// Writes one byte to [fraction] (0-1) of the pages of the region at [base],
+// spread evenly over it. Returns the number of pages written.
+long touch_fraction(char* base, long total, double fraction);
+
+// Reads the number that follows [key] at the start of a line in the file at
+// [path], e.g. "MemFree" in /proc/meminfo or "oom_kill" in memory.events.
+// Returns -1 if the file or the key is not available.
+long long read_keyed_value(const char* path, const char* key);
+
+// Reads the number at the start of the file at [path], e.g. memory.current.
+// Returns -1 if the file is not available or does not start with a number
+// (like "max").
+long long read_value(const char* path);
+
+// Returns the resident set size of this process in bytes, or -1 if it is not
+// available.
+long long rss_bytes();
+
+// Resolves the path of a memory controller file of the cgroup this process
+// belongs to, trying the unified hierarchy ([v2_name]) first and the v1 memory
+// controller ([v1_name]) second. Returns false if neither file exists.
+bool cgroup_memory_file(const char* v2_name, const char* v1_name, char* path, size_t len);
+
+// Returns the number of OOM kills recorded for this process's cgroup, falling
+// back to the system wide counter. Returns -1 if neither is available.
+long long oom_kill_count();
+
+// Returns the memory limit of this process's cgroup in bytes, or -1 if there
+// is none.
+long long cgroup_memory_limit();
+
+// Returns the memory charged to this process's cgroup in bytes, or -1 if it
+// is not available.
+long long cgroup_memory_usage();
+
+// Returns the total time in microseconds that tasks of this process's cgroup,
+// or of the system, have stalled on memory ("some" in the PSI memory file).
+// Returns -1 if pressure stall information is not available.
+long long memory_stall_us();
+
+#endif
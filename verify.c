@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "util.h"
+#include "verify.h"
+
+// Odd constant that makes consecutive words of a page differ.
+#define STRIDE 0x9e3779b97f4a7c15ULL
+
+// Returns the first word of the pattern of the page at [page].
+static uint64_t page_key(const char* page, uint64_t seed) {
+    uint64_t x = (uint64_t)(uintptr_t)page ^ seed;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// The loops below are written so the compiler vectorizes them: one
+// independent value per word and a single OR reduction.
+void verify_fill(char* base, long size, uint64_t seed) {
+    long page = sysconf(_SC_PAGE_SIZE);
+    long words = page / sizeof(uint64_t);
+    for(long offset = 0; offset + page <= size; offset += page) {
+        uint64_t* w = (uint64_t*)(base + offset);
+        uint64_t key = page_key(base + offset, seed);
+        for(long i = 0; i < words; i++) {
+            w[i] = key + i * STRIDE;
+        }
+    }
+}
+
+void verify_pages(VerifyResult* result, char* base, long size, uint64_t seed) {
+    long page = sysconf(_SC_PAGE_SIZE);
+    long words = page / sizeof(uint64_t);
+    for(long offset = 0; offset + page <= size; offset += page) {
+        const uint64_t* w = (const uint64_t*)(base + offset);
+        uint64_t key = page_key(base + offset, seed);
+        uint64_t diff = 0;
+        for(long i = 0; i < words; i++) {
+            diff |= w[i] ^ (key + i * STRIDE);
+        }
+        result->pages++;
+        if(diff != 0) {
+            if(result->mismatched < VERIFY_MAX_REPORTED) {
+                result->reported[result->mismatched] = base + offset;
+            }
+            result->mismatched++;
+        }
+    }
+}
+
+void verify_fill_extents(Extents* extents, uint64_t seed) {
+    for(long i = 0; i < extents->count; i++) {
+        verify_fill(extents->bases[i], extents->sizes[i], seed);
+    }
+}
+
+bool verify_extents(Extents* extents, uint64_t seed) {
+    VerifyResult result = {0, 0, {NULL}};
+    long long start = now_ns();
+    for(long i = 0; i < extents->count; i++) {
+        verify_pages(&result, extents->bases[i], extents->sizes[i], seed);
+    }
+    long long elapsed = now_ns() - start;
+    printf("Verified %ld pages in %.1f ms (%.2f GB/s): %ld mismatched\n", result.pages, elapsed / 1e6,
+        elapsed > 0 ? (double)extents->total / elapsed : 0, result.mismatched);
+    for(long i = 0; i < result.mismatched && i < VERIFY_MAX_REPORTED; i++) {
+        printf("  mismatch at %p\n", (void*)result.reported[i]);
+    }
+    if(result.mismatched > VERIFY_MAX_REPORTED) {
+        printf("  ... and %ld more\n", result.mismatched - VERIFY_MAX_REPORTED);
+    }
+    fflush(stdout);
+    return result.mismatched == 0;
+}
@@ -0,0 +1,32 @@
+#ifndef verify_h
+#define verify_h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "eat.h"
+
+// Maximum number of mismatched page addresses kept by verify_pages().
+#define VERIFY_MAX_REPORTED 16
+
+typedef struct {
+    long pages;
+    long mismatched;
+    char* reported[VERIFY_MAX_REPORTED];
+} VerifyResult;
+
+// Fills every page of [size] bytes at [base] (page aligned) with a pattern
+// derived from [seed] and the page's address.
+void verify_fill(char* base, long size, uint64_t seed);
+
+// Checks the pages written by verify_fill() and adds the pages that don't
+// match to [result].
+void verify_pages(VerifyResult* result, char* base, long size, uint64_t seed);
+
+// Fills every extent with verify_fill().
+void verify_fill_extents(Extents* extents, uint64_t seed);
+
+// Checks every extent, printing the throughput and the addresses of the
+// first mismatched pages. Returns false if any page did not match.
+bool verify_extents(Extents* extents, uint64_t seed);
+
+#endif
@@ -0,0 +1,214 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sched.h>
+#include "histogram.h"
+#include "util.h"
+#include "victim.h"
+
+#define BASELINE_NS 1000000000LL
+#define NAME_LEN 24
+// Lookups timed together, so that reading the clock does not dominate what is
+// measured; each batch records its average lookup latency.
+#define LOOKUP_BATCH 32
+
+typedef struct {
+    uint64_t key;
+    uint64_t value;
+} Slot;
+
+struct Victim {
+    pthread_t thread;
+    int cpu;
+    // Open addressing table at 50% load, and the keys it holds.
+    Slot* slots;
+    long mask;
+    uint64_t* keys;
+    long key_count;
+    volatile bool stop;
+    // Index of the phase lookups are recorded in, published by victim_phase()
+    // once its histogram is ready.
+    int phase;
+    int phase_count;
+    // Phases not measured because VICTIM_MAX_PHASES was reached.
+    int dropped;
+    char names[VICTIM_MAX_PHASES][NAME_LEN];
+    Histogram* hists[VICTIM_MAX_PHASES];
+    uint64_t sink;
+};
+
+static uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static void* lookup(void* arg) {
+    Victim* v = arg;
+#ifdef __linux__
+    if(v->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(v->cpu, &set);
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+#endif
+    unsigned long long state = 2463534242ULL;
+    uint64_t sum = 0;
+    while(!v->stop) {
+        long long start = now_ns();
+        for(int b = 0; b < LOOKUP_BATCH; b++) {
+            uint64_t key = v->keys[xorshift(&state) % v->key_count];
+            for(long i = mix(key) & v->mask; v->slots[i].key != 0; i = (i + 1) & v->mask) {
+                if(v->slots[i].key == key) {
+                    sum += v->slots[i].value;
+                    break;
+                }
+            }
+        }
+        hist_record(v->hists[__atomic_load_n(&v->phase, __ATOMIC_ACQUIRE)], (now_ns() - start) / LOOKUP_BATCH);
+    }
+    v->sink = sum;
+    return NULL;
+}
+
+// Picks the last CPU this process may run on if it is not the one the caller
+// is running on. Returns -1 if there is no such CPU.
+static int spare_cpu() {
+#ifdef __linux__
+    cpu_set_t set;
+    if(sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for(int cpu = CPU_SETSIZE - 1; cpu >= 0; cpu--) {
+            if(CPU_ISSET(cpu, &set)) {
+                return cpu != sched_getcpu() ? cpu : -1;
+            }
+        }
+    }
+#endif
+    return -1;
+}
+
+Victim* victim_start(long working_set) {
+    Victim* v = calloc(1, sizeof(Victim));
+    if(v == NULL) {
+        return NULL;
+    }
+    long slots = 1;
+    while(slots * 2 * (long)sizeof(Slot) <= working_set) {
+        slots *= 2;
+    }
+    v->slots = calloc(slots, sizeof(Slot));
+    v->mask = slots - 1;
+    v->key_count = slots / 2;
+    v->keys = malloc(sizeof(uint64_t) * v->key_count);
+    v->hists[0] = malloc(sizeof(Histogram));
+    if(v->slots == NULL || v->keys == NULL || v->hists[0] == NULL || v->key_count == 0) {
+        free(v->slots);
+        free(v->keys);
+        free(v->hists[0]);
+        free(v);
+        return NULL;
+    }
+    unsigned long long state = 88172645463325252ULL;
+    for(long k = 0; k < v->key_count; k++) {
+        uint64_t key = xorshift(&state) | 1;
+        long i = mix(key) & v->mask;
+        while(v->slots[i].key != 0) {
+            i = (i + 1) & v->mask;
+        }
+        v->slots[i].key = key;
+        v->slots[i].value = k;
+        v->keys[k] = key;
+    }
+    hist_clear(v->hists[0]);
+    snprintf(v->names[0], NAME_LEN, "before");
+    v->phase_count = 1;
+    v->cpu = spare_cpu();
+    // The thread starts with SIGINT and SIGTERM blocked, leaving them to the
+    // event loop of the main thread.
+    sigset_t mask, old_mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &mask, &old_mask);
+    int created = pthread_create(&v->thread, NULL, lookup, v);
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+    if(created != 0) {
+        free(v->slots);
+        free(v->keys);
+        free(v->hists[0]);
+        free(v);
+        return NULL;
+    }
+    if(v->cpu >= 0) {
+        printf("Victim: %ld KiB hash table on CPU %d, measuring the baseline...\n", slots * (long)sizeof(Slot) / 1024, v->cpu);
+    } else {
+        printf("Victim: %ld KiB hash table, time sharing the only CPU, measuring the baseline...\n", slots * (long)sizeof(Slot) / 1024);
+    }
+    volatile sig_atomic_t never = 0;
+    sleep_ns(BASELINE_NS, &never);
+    return v;
+}
+
+// Starts the phase called [name], unless memory allocation fails.
+static void add_phase(Victim* v, const char* name) {
+    Histogram* hist = malloc(sizeof(Histogram));
+    if(hist == NULL) {
+        return;
+    }
+    hist_clear(hist);
+    snprintf(v->names[v->phase_count], NAME_LEN, "%s", name);
+    v->hists[v->phase_count] = hist;
+    __atomic_store_n(&v->phase, v->phase_count++, __ATOMIC_RELEASE);
+}
+
+void victim_phase(Victim* v, const char* name) {
+    if(v == NULL) {
+        return;
+    } else if(v->phase_count >= VICTIM_MAX_PHASES - 1) {
+        // The last slot is kept for "after".
+        v->dropped++;
+        return;
+    }
+    add_phase(v, name);
+}
+
+// Prints a latency and its change relative to [base].
+static void print_latency(long long ns, long long base) {
+    printf("  %8lld  %+8.1f%%", ns, base > 0 ? 100.0 * (ns - base) / base : 0);
+}
+
+void victim_finish(Victim* v) {
+    if(v == NULL) {
+        return;
+    }
+    add_phase(v, "after");
+    volatile sig_atomic_t never = 0;
+    sleep_ns(BASELINE_NS, &never);
+    v->stop = true;
+    pthread_join(v->thread, NULL);
+
+    long long p50 = hist_percentile(v->hists[0], 50);
+    long long p99 = hist_percentile(v->hists[0], 99);
+    printf("\n%-16s  %10s  %8s  %9s  %8s  %9s\n", "VICTIM_PHASE", "LOOKUPS", "P50_NS", "P50_DEG", "P99_NS", "P99_DEG");
+    for(int i = 0; i < v->phase_count; i++) {
+        printf("%-16s  %10lld", v->names[i], v->hists[i]->total * LOOKUP_BATCH);
+        print_latency(hist_percentile(v->hists[i], 50), p50);
+        print_latency(hist_percentile(v->hists[i], 99), p99);
+        printf("\n");
+        free(v->hists[i]);
+    }
+    if(v->dropped > 0) {
+        printf("%d later phases were not measured separately\n", v->dropped);
+    }
+    free(v->slots);
+    free(v->keys);
+    free(v);
+}
@@ -0,0 +1,27 @@
+#ifndef victim_h
+#define victim_h
+
+// Maximum number of phases a victim measures, including before and after.
+#define VICTIM_MAX_PHASES 72
+
+// A thread running a small latency sensitive workload next to the memory
+// pressure: lookups in a hash table spread over a private working set.
+typedef struct Victim Victim;
+
+// Starts the victim with a [working_set] byte table, pinned to a CPU other
+// than the caller's when there is one, and measures its "before" phase for a
+// second. Returns NULL if it could not be started.
+Victim* victim_start(long working_set);
+
+// Ends the current phase and starts one called [name]; lookups from now on
+// count towards it. Does nothing once only the slot for "after" is left, so
+// the lookups count towards the last phase started.
+void victim_phase(Victim* victim, const char* name);
+
+// Measures the "after" phase for a second, stops the victim, and prints the
+// p50 and p99 lookup latency of every phase along with its degradation
+// relative to "before". Lookups are timed in small batches, so the
+// percentiles are of the batch averages. Frees the victim.
+void victim_finish(Victim* victim);
+
+#endif